@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+
+"""
+Times the Speller methods on the word corpora, using the installed sibel module.
+The name of each corpus file is the code of the Hunspell dictionary to load (de_DE.txt).
+Writes one JSON object to stdout.
+"""
+
+import argparse
+import json
+import os
+import resource
+import sys
+import time
+
+import sibel
+
+METHODS = ('spell', 'suggest', 'stem', 'analyse', 'orthographic_forms')
+
+
+def read_corpus(path: str) -> list[str]:
+	with open(path, encoding='utf-8') as f:
+		return [line.strip() for line in f if line.strip() and not line.startswith('#')]
+
+
+def percentile(values: list[int], p: float) -> int:
+	values = sorted(values)
+	return values[int(p * (len(values) - 1))]
+
+
+def time_method(speller: sibel.Speller, method: str, words: list[str], repeat: int, **kwargs) -> dict:
+	f = getattr(speller, method)
+	latencies = []
+	items = 0
+	for _ in range(repeat):
+		for word in words:
+			start = time.perf_counter_ns()
+			result = f(word, **kwargs)
+			latencies.append(time.perf_counter_ns() - start)
+			items += len(result) if isinstance(result, list) else 1
+	total = sum(latencies)
+	return {
+		'calls': len(latencies),
+		'items': items,
+		'calls_per_s': round(len(latencies) / (total / 1e9), 1),
+		'p50_ns': percentile(latencies, 0.5),
+		'p99_ns': percentile(latencies, 0.99),
+	}
+
+
+def main() -> None:
+	parser = argparse.ArgumentParser(description=__doc__)
+	parser.add_argument('corpora', nargs='+')
+	parser.add_argument('--dict-dir', default='/usr/share/hunspell')
+	parser.add_argument('--repeat', type=int, default=20)
+	parser.add_argument('--prune-candidates', action='store_true')
+	parser.add_argument('--orthographic-index', action='store_true')
+	parser.add_argument('--word-set', action='store_true')
+	parser.add_argument('--suggestion-index', action='store_true')
+	parser.add_argument('--top-k', type=int)
+	args = parser.parse_args()
+
+	results = []
+	for path in args.corpora:
+		lang_code = os.path.splitext(os.path.basename(path))[0]
+		try:
+			start = time.perf_counter_ns()
+			speller = sibel.Speller(args.dict_dir, lang_code, prune_candidates=args.prune_candidates, orthographic_index=args.orthographic_index, word_set=args.word_set, suggestion_index=args.suggestion_index)
+			load_ns = time.perf_counter_ns() - start
+		except sibel.DictionaryLoadingError as e:
+			print(f'{lang_code}: {e}, skipped', file=sys.stderr)
+			continue
+
+		words = read_corpus(path)
+		results.append({'name': 'Speller', 'lang': lang_code, 'load_ns': load_ns})
+		for method in METHODS:
+			results.append({'name': method, 'lang': lang_code, **time_method(speller, method, words, args.repeat)})
+		if args.suggestion_index:
+			results.append({'name': 'suggest_fast', 'lang': lang_code, **time_method(speller, 'suggest', words, args.repeat, engine='fast')})
+		if args.top_k is not None:
+			results.append({'name': 'orthographic_forms_top_k', 'lang': lang_code, **time_method(speller, 'orthographic_forms', words, args.repeat, top_k=args.top_k)})
+
+	json.dump({
+		'benchmark': 'speller',
+		'repeat': args.repeat,
+		'prune_candidates': args.prune_candidates,
+		'orthographic_index': args.orthographic_index,
+		'word_set': args.word_set,
+		'suggestion_index': args.suggestion_index,
+		'top_k': args.top_k,
+		'peak_rss_kb': resource.getrusage(resource.RUSAGE_SELF).ru_maxrss,
+		'results': results,
+	}, sys.stdout, indent='\t')
+	print()
+
+
+if __name__ == '__main__':
+	main()
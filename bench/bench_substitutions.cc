@@ -0,0 +1,160 @@
+/**
+ * Times the substitution engine and simplify() on the word corpora, without Hunspell.
+ * Usage: bench_substitutions [--repeat N] corpus...
+ * The name of each corpus file starts with its language code (de_DE.txt).
+ * Writes one JSON object to stdout.
+ */
+
+#include "sibel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sys/resource.h>
+
+struct measurement
+{
+	std::string name;
+	std::string lang;
+	int length; // word length in bytes, or -1 for the whole corpus
+	std::vector<double> latencies_ns = {};
+	double total_ns = 0;
+	std::size_t items = 0; // candidates generated, or calls
+};
+
+static std::vector<std::string> read_corpus(const char *path)
+{
+	std::vector<std::string> words;
+	std::ifstream file(path);
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (!line.empty() && line[0] != '#')
+		{
+			words.push_back(line);
+		}
+	}
+	return words;
+}
+
+template <typename F>
+static void time_calls(measurement &m, const std::vector<std::string> &words, int repeat, F f)
+{
+	for (int r = 0; r < repeat; ++r)
+	{
+		for (const std::string &word : words)
+		{
+			auto start = std::chrono::steady_clock::now();
+			m.items += f(word);
+			auto end = std::chrono::steady_clock::now();
+			double ns = std::chrono::duration<double, std::nano>(end - start).count();
+			m.latencies_ns.push_back(ns);
+			m.total_ns += ns;
+		}
+	}
+}
+
+static double percentile(std::vector<double> &values, double p)
+{
+	if (values.empty())
+	{
+		return 0;
+	}
+	std::size_t k = static_cast<std::size_t>(p * (values.size() - 1));
+	std::nth_element(values.begin(), values.begin() + k, values.end());
+	return values[k];
+}
+
+int main(int argc, char **argv)
+{
+	int repeat = 20;
+	std::vector<const char *> corpora;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+		{
+			repeat = std::max(1, std::atoi(argv[++i]));
+		}
+		else
+		{
+			corpora.push_back(argv[i]);
+		}
+	}
+
+	std::vector<measurement> measurements;
+	for (const char *path : corpora)
+	{
+		std::string lang = std::filesystem::path(path).stem().string();
+		std::vector<std::string> words = read_corpus(path);
+		if (words.empty())
+		{
+			std::fprintf(stderr, "%s: no words\n", path);
+			continue;
+		}
+
+		measurement substitutable{"is_substitutable", lang, -1};
+		time_calls(substitutable, words, repeat, [](const std::string &word)
+		{
+			return substitution_table::is_substitutable(word) ? 1 : 0;
+		});
+		measurements.push_back(std::move(substitutable));
+
+		std::string simplified;
+		measurement simplification{"simplify", lang, -1};
+		time_calls(simplification, words, repeat, [&simplified](const std::string &word)
+		{
+			simplify(word, simplified);
+			return 1;
+		});
+		measurements.push_back(std::move(simplification));
+
+		const substitution_table *table = substitution_table::find(std::string_view(lang).substr(0, 2));
+		if (!table)
+		{
+			continue;
+		}
+
+		// Grouped by length too, since the cost grows exponentially with it
+		std::map<int, std::vector<std::string>> by_length;
+		for (const std::string &word : words)
+		{
+			by_length[static_cast<int>(word.size())].push_back(word);
+		}
+		auto substitute = [table](const std::string &word)
+		{
+			return table->substitute(word).size();
+		};
+		measurement overall{"substitute", lang, -1};
+		time_calls(overall, words, repeat, substitute);
+		measurements.push_back(std::move(overall));
+		for (const auto &[length, group] : by_length)
+		{
+			measurement m{"substitute", lang, length};
+			time_calls(m, group, repeat, substitute);
+			measurements.push_back(std::move(m));
+		}
+	}
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	std::printf("{\"benchmark\": \"substitutions\", \"repeat\": %d, \"peak_rss_kb\": %ld, \"results\": [", repeat, usage.ru_maxrss);
+	for (std::size_t i = 0; i < measurements.size(); ++i)
+	{
+		measurement &m = measurements[i];
+		std::size_t calls = m.latencies_ns.size();
+		std::printf("%s\n\t{\"name\": \"%s\", \"lang\": \"%s\", ", i ? "," : "", m.name.c_str(), m.lang.c_str());
+		if (m.length >= 0)
+		{
+			std::printf("\"length\": %d, ", m.length);
+		}
+		std::printf("\"calls\": %zu, \"items\": %zu, \"calls_per_s\": %.1f, \"p50_ns\": %.1f, \"p99_ns\": %.1f}",
+			calls, m.items, calls / (m.total_ns / 1e9), percentile(m.latencies_ns, 0.5), percentile(m.latencies_ns, 0.99));
+	}
+	std::printf("\n]}\n");
+	return 0;
+}
@@ -28,7 +28,7 @@ setup(
 	ext_modules=[
 		Extension(
 			'sibel',
-			['src/substitutions.cc', 'src/simplification.cc', 'src/sibelmodule.cc'],
+			['src/substitutions.cc', 'src/classify.cc', 'src/simplification.cc', 'src/words.cc', 'src/dictionary.cc', 'src/index.cc', 'src/word_set.cc', 'src/deletions.cc', 'src/frequencies.cc', 'src/mapped_file.cc', 'src/backends.cc', 'src/replicas.cc', 'src/thread_pool.cc', 'src/sibelmodule.cc'],
 			include_dirs=include_dirs,
 			library_dirs=library_dirs,
 			libraries=libraries,
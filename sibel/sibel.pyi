@@ -1,11 +1,48 @@
 # Reprising the content of __init__, just to be safe
 
+import os
+import asyncio
+from typing import Any, Iterable, Iterator, Literal
+
 class DictionaryLoadingError(Exception): ...
 
+def get_thread_pool_size() -> int: ...
+def set_thread_pool_size(size: int) -> None: ...
+def stats() -> dict[str, Any]: ...
+def get_stats_enabled() -> bool: ...
+def set_stats_enabled(enabled: bool) -> None: ...
+
+class ResultList(list[str]):
+	partial: bool
+
 class Speller:
-	def __init__(self, base_path: str, lang_code: str) -> None: ...
+	def __init__(self, base_path: str, lang_code: str, prune_candidates: bool = False, orthographic_index: bool = False, cache_dir: str | None = None, threads: int = 1, cache_size: int | dict[str, int] | None = None, substitution_table: str | None = None, lazy: bool = False, word_set: bool = False, suggestion_index: bool = False, frequencies: str | None = None) -> None: ...
 	def spell(self, word: str) -> bool: ...
-	def suggest(self, word: str) -> list[str]: ...
+	def suggest(self, word: str, max_results: int | None = None, timeout_ms: float | None = None, engine: Literal['hunspell', 'fast'] = 'hunspell', top_k: int | None = None) -> list[str]: ...
 	def analyse(self, word: str) -> list[str]: ...
 	def stem(self, word: str) -> list[str]: ...
+	def orthographic_forms(self, word: str, max_results: int | None = None, timeout_ms: float | None = None, top_k: int | None = None) -> list[str]: ...
+	def spell_many(self, words: Iterable[str]) -> bytes: ...
+	def suggest_many(self, words: Iterable[str]) -> list[list[str]]: ...
+	def analyse_many(self, words: Iterable[str]) -> list[list[str]]: ...
+	def stem_many(self, words: Iterable[str]) -> list[list[str]]: ...
+	def add(self, word: str) -> None: ...
+	def check_text(self, text: str, suggest: bool = False) -> list[tuple[int, str, list[str] | None]]: ...
+	def check_file(self, path: str | bytes | os.PathLike[str], suggest: bool = False) -> Iterator[tuple[int, str, list[str] | None]]: ...
+	def aspell(self, word: str) -> asyncio.Future[bool]: ...
+	def asuggest(self, word: str, max_results: int | None = None, timeout_ms: float | None = None, engine: Literal['hunspell', 'fast'] = 'hunspell', top_k: int | None = None) -> asyncio.Future[list[str]]: ...
+	def aanalyse(self, word: str) -> asyncio.Future[list[str]]: ...
+	def astem(self, word: str) -> asyncio.Future[list[str]]: ...
+	def aorthographic_forms(self, word: str, max_results: int | None = None, timeout_ms: float | None = None, top_k: int | None = None) -> asyncio.Future[list[str]]: ...
+	def acheck_text(self, text: str, suggest: bool = False) -> asyncio.Future[list[tuple[int, str, list[str] | None]]]: ...
+	def cache_info(self) -> dict[str, dict[str, int]]: ...
+	def stats(self) -> dict[str, Any]: ...
+
+class MultiSpeller:
+	lang_codes: tuple[str, ...]
+	spellers: tuple[Speller, ...]
+	def __init__(self, base_path: str, lang_codes: Iterable[str], prune_candidates: bool = False, orthographic_index: bool = False, cache_dir: str | None = None, threads: int = 1, cache_size: int | dict[str, int] | None = None, substitution_table: str | dict[str, str] | None = None, lazy: bool = False, word_set: bool = False, suggestion_index: bool = False, frequencies: str | dict[str, str] | None = None) -> None: ...
+	def spell(self, word: str) -> tuple[str, ...]: ...
+	def suggest(self, word: str) -> list[str]: ...
 	def orthographic_forms(self, word: str) -> list[str]: ...
+	def check_text(self, text: str, suggest: bool = False) -> list[tuple[int, str, list[str] | None]]: ...
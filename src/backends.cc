@@ -0,0 +1,42 @@
+#include "sibel.h"
+
+#include <hunspell/hunspell.hxx>
+
+spelling_backend::~spelling_backend() = default;
+
+hunspell_backend::hunspell_backend(const std::filesystem::path &aff_path, const std::filesystem::path &dic_path) : hunspell(std::make_unique<Hunspell>(aff_path.c_str(), dic_path.c_str())) {}
+
+hunspell_backend::~hunspell_backend() = default;
+
+backend_loader hunspell_backend::loader(const std::filesystem::path &aff_path, const std::filesystem::path &dic_path)
+{
+	return [aff_path, dic_path]() -> std::unique_ptr<spelling_backend>
+	{
+		return std::make_unique<hunspell_backend>(aff_path, dic_path);
+	};
+}
+
+bool hunspell_backend::spell(const std::string &word)
+{
+	return hunspell->spell(word);
+}
+
+std::vector<std::string> hunspell_backend::suggest(const std::string &word)
+{
+	return hunspell->suggest(word);
+}
+
+std::vector<std::string> hunspell_backend::analyse(const std::string &word)
+{
+	return hunspell->analyze(word);
+}
+
+std::vector<std::string> hunspell_backend::stem(const std::string &word)
+{
+	return hunspell->stem(word);
+}
+
+void hunspell_backend::add(const std::string &word)
+{
+	hunspell->add(word);
+}
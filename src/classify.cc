@@ -0,0 +1,139 @@
+#include "sibel.h"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define SIBEL_X86 1
+#endif
+
+/*
+ * All versions look at each byte for the same things and merge the results in a
+ * text_class. The banned U+2019 is found by its lead byte 0xE2, which is then checked
+ * in full; that is rare enough not to need vectorising.
+ */
+
+static bool is_right_quote_at(std::string_view s, std::size_t i)
+{
+	return i + 3 <= s.size() && std::memcmp(s.data() + i, "\xE2\x80\x99", 3) == 0;
+}
+
+static void classify_scalar(std::string_view s, std::size_t from, text_class &c)
+{
+	for (std::size_t i = from; i < s.size(); ++i)
+	{
+		unsigned char b = s[i];
+		c.ascii &= b < 0x80;
+		c.printable_ascii &= b >= 0x21 && b <= 0x7E;
+		c.whitespace |= b == ' ' || (b >= '\t' && b <= '\r');
+		c.banned |= b == ' ' || b == '-' || b == '\'' || (b == 0xE2 && is_right_quote_at(s, i));
+	}
+}
+
+#ifdef SIBEL_X86
+
+/**
+ * Merges the byte masks of one block into c. Bit i of each mask stands for byte i.
+ */
+static void merge_masks(std::string_view s, std::size_t block, std::uint32_t non_ascii, std::uint32_t non_printable, std::uint32_t whitespace, std::uint32_t banned, std::uint32_t quote_leads, text_class &c)
+{
+	c.ascii &= non_ascii == 0;
+	c.printable_ascii &= non_printable == 0;
+	c.whitespace |= whitespace != 0;
+	c.banned |= banned != 0;
+	while (quote_leads != 0 && !c.banned)
+	{
+		c.banned = is_right_quote_at(s, block + __builtin_ctz(quote_leads));
+		quote_leads &= quote_leads - 1;
+	}
+}
+
+static std::size_t classify_sse2(std::string_view s, text_class &c)
+{
+	const __m128i printable_offset = _mm_set1_epi8(0x21);
+	const __m128i printable_range = _mm_set1_epi8(0x7E - 0x21);
+	const __m128i control_offset = _mm_set1_epi8('\t');
+	const __m128i control_range = _mm_set1_epi8('\r' - '\t');
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i hyphen = _mm_set1_epi8('-');
+	const __m128i apostrophe = _mm_set1_epi8('\'');
+	const __m128i quote_lead = _mm_set1_epi8(static_cast<char>(0xE2));
+
+	std::size_t i = 0;
+	for (; i + 16 <= s.size(); i += 16)
+	{
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s.data() + i));
+		// x <= range as unsigned bytes, after subtracting the bottom of the range
+		__m128i p = _mm_sub_epi8(b, printable_offset);
+		__m128i printable = _mm_cmpeq_epi8(_mm_min_epu8(p, printable_range), p);
+		__m128i t = _mm_sub_epi8(b, control_offset);
+		__m128i control = _mm_cmpeq_epi8(_mm_min_epu8(t, control_range), t);
+		__m128i spaces = _mm_cmpeq_epi8(b, space);
+		__m128i banned = _mm_or_si128(spaces, _mm_or_si128(_mm_cmpeq_epi8(b, hyphen), _mm_cmpeq_epi8(b, apostrophe)));
+
+		merge_masks(s, i,
+			static_cast<std::uint32_t>(_mm_movemask_epi8(b)),
+			static_cast<std::uint32_t>(~_mm_movemask_epi8(printable)) & 0xFFFF,
+			static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_or_si128(spaces, control))),
+			static_cast<std::uint32_t>(_mm_movemask_epi8(banned)),
+			static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(b, quote_lead))),
+			c);
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static std::size_t classify_avx2(std::string_view s, text_class &c)
+{
+	const __m256i printable_offset = _mm256_set1_epi8(0x21);
+	const __m256i printable_range = _mm256_set1_epi8(0x7E - 0x21);
+	const __m256i control_offset = _mm256_set1_epi8('\t');
+	const __m256i control_range = _mm256_set1_epi8('\r' - '\t');
+	const __m256i space = _mm256_set1_epi8(' ');
+	const __m256i hyphen = _mm256_set1_epi8('-');
+	const __m256i apostrophe = _mm256_set1_epi8('\'');
+	const __m256i quote_lead = _mm256_set1_epi8(static_cast<char>(0xE2));
+
+	std::size_t i = 0;
+	for (; i + 32 <= s.size(); i += 32)
+	{
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s.data() + i));
+		__m256i p = _mm256_sub_epi8(b, printable_offset);
+		__m256i printable = _mm256_cmpeq_epi8(_mm256_min_epu8(p, printable_range), p);
+		__m256i t = _mm256_sub_epi8(b, control_offset);
+		__m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(t, control_range), t);
+		__m256i spaces = _mm256_cmpeq_epi8(b, space);
+		__m256i banned = _mm256_or_si256(spaces, _mm256_or_si256(_mm256_cmpeq_epi8(b, hyphen), _mm256_cmpeq_epi8(b, apostrophe)));
+
+		merge_masks(s, i,
+			static_cast<std::uint32_t>(_mm256_movemask_epi8(b)),
+			~static_cast<std::uint32_t>(_mm256_movemask_epi8(printable)),
+			static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(spaces, control))),
+			static_cast<std::uint32_t>(_mm256_movemask_epi8(banned)),
+			static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(b, quote_lead))),
+			c);
+	}
+	return i;
+}
+
+#endif
+
+text_class classify(std::string_view s)
+{
+	text_class c{true, true, false, false};
+	std::size_t done = 0;
+#ifdef SIBEL_X86
+	// Words are short; the vector loops only pay off on longer strings
+	static const bool has_avx2 = __builtin_cpu_supports("avx2");
+	if (s.size() >= 32 && has_avx2)
+	{
+		done = classify_avx2(s, c);
+	}
+	else if (s.size() >= 16)
+	{
+		done = classify_sse2(s, c);
+	}
+#endif
+	classify_scalar(s, done, c);
+	return c;
+}
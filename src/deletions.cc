@@ -0,0 +1,342 @@
+#include "sibel.h"
+
+#include <cstring>
+#include <tuple>
+#include <unicode/utf8.h>
+
+const std::size_t deletion_index::MAX_FORMS = 10000000;
+const std::uint32_t deletion_index::FILE_VERSION = 2;
+const std::size_t deletion_index::MAX_DISTANCE = 2;
+const std::size_t deletion_index::PREFIX_LENGTH = 7;
+
+static const char DELETION_MAGIC[8] = {'S', 'I', 'B', 'E', 'L', 'D', 'E', 'L'};
+
+static std::u32string decode_utf8(std::string_view s)
+{
+	std::u32string result;
+	int32_t i = 0;
+	int32_t length = static_cast<int32_t>(s.size());
+	while (i < length)
+	{
+		UChar32 c;
+		U8_NEXT(s.data(), i, length, c);
+		result.push_back(c < 0 ? 0xFFFD : c);
+	}
+	return result;
+}
+
+static std::uint64_t hash_code_points(const std::u32string &s)
+{
+	// FNV-1a, then mixed so that the top bits, which pick the directory slot, are as good as the rest
+	std::uint64_t h = 0xcbf29ce484222325ULL;
+	for (char32_t c : s)
+	{
+		h ^= c;
+		h *= 0x100000001b3ULL;
+	}
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return h;
+}
+
+/**
+ * Adds the hashes of s and of what is left of it after deleting up to depth more code
+ * points at positions from onwards, so that each set of positions is only tried once.
+ */
+static void add_deletions(const std::u32string &s, std::size_t from, std::size_t depth, std::vector<std::uint64_t> &hashes)
+{
+	hashes.push_back(hash_code_points(s));
+	if (depth == 0)
+	{
+		return;
+	}
+	for (std::size_t i = from; i < s.size(); ++i)
+	{
+		std::u32string shorter(s);
+		shorter.erase(i, 1);
+		add_deletions(shorter, i, depth - 1, hashes);
+	}
+}
+
+/**
+ * The optimal string alignment distance between a and b, or limit + 1 once it is known
+ * to be greater than limit.
+ */
+static std::size_t edit_distance(const std::u32string &a, const std::u32string &b, std::size_t limit)
+{
+	if ((a.size() > b.size() ? a.size() - b.size() : b.size() - a.size()) > limit)
+	{
+		return limit + 1;
+	}
+
+	std::vector<std::size_t> before(b.size() + 1);
+	std::vector<std::size_t> previous(b.size() + 1);
+	std::vector<std::size_t> current(b.size() + 1);
+	for (std::size_t j = 0; j <= b.size(); ++j)
+	{
+		previous[j] = j;
+	}
+	for (std::size_t i = 1; i <= a.size(); ++i)
+	{
+		current[0] = i;
+		std::size_t row_min = i;
+		for (std::size_t j = 1; j <= b.size(); ++j)
+		{
+			std::size_t cost = a[i - 1] == b[j - 1] ? 0 : 1;
+			current[j] = std::min({previous[j] + 1, current[j - 1] + 1, previous[j - 1] + cost});
+			if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1])
+			{
+				current[j] = std::min(current[j], before[j - 2] + 1);
+			}
+			row_min = std::min(row_min, current[j]);
+		}
+		if (row_min > limit)
+		{
+			return limit + 1;
+		}
+		std::swap(before, previous);
+		std::swap(previous, current);
+	}
+	return std::min(previous[b.size()], limit + 1);
+}
+
+deletion_index::deletion_index() : image_size(0), hdr(nullptr), directory(nullptr), entries(nullptr), forms(nullptr), arena(nullptr) {}
+
+void deletion_index::attach(const void *image)
+{
+	hdr = static_cast<const header *>(image);
+	directory = reinterpret_cast<const std::uint32_t *>(hdr + 1);
+	entries = reinterpret_cast<const entry *>(directory + (std::uint64_t(1) << hdr->directory_bits) + 1);
+	forms = reinterpret_cast<const form_ref *>(entries + hdr->n_entries);
+	arena = reinterpret_cast<const char *>(forms + hdr->n_forms);
+}
+
+void deletion_index::deletions(const std::u32string &word, std::vector<std::uint64_t> &hashes)
+{
+	hashes.clear();
+	add_deletions(word.substr(0, PREFIX_LENGTH), 0, MAX_DISTANCE, hashes);
+	std::sort(hashes.begin(), hashes.end());
+	hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+}
+
+deletion_index *deletion_index::build(const affix_dictionary &dictionary)
+{
+	std::string raw;
+	std::vector<std::uint32_t> raw_offsets;
+	bool complete = dictionary.expand([&](const std::string &form, bool standalone)
+	{
+		if (standalone)
+		{
+			raw_offsets.push_back(static_cast<std::uint32_t>(raw.size()));
+			raw += form;
+		}
+	}, MAX_FORMS);
+	if (!complete || raw.size() > UINT32_MAX)
+	{
+		return nullptr;
+	}
+	raw_offsets.push_back(static_cast<std::uint32_t>(raw.size()));
+
+	auto raw_form = [&](std::uint32_t i)
+	{
+		return std::string_view(raw).substr(raw_offsets[i], raw_offsets[i + 1] - raw_offsets[i]);
+	};
+
+	std::vector<std::uint32_t> order(raw_offsets.size() - 1);
+	for (std::uint32_t i = 0; i < order.size(); ++i)
+	{
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b)
+	{
+		return raw_form(a) < raw_form(b);
+	});
+	order.erase(std::unique(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b)
+	{
+		return raw_form(a) == raw_form(b);
+	}), order.end());
+
+	// The forms are numbered in byte order
+	std::vector<form_ref> new_forms;
+	std::string new_arena;
+	std::vector<std::pair<std::uint64_t, std::uint32_t>> filed;
+	std::vector<std::uint64_t> hashes;
+	for (std::uint32_t i : order)
+	{
+		std::string_view form = raw_form(i);
+		std::uint32_t id = static_cast<std::uint32_t>(new_forms.size());
+		new_forms.push_back({static_cast<std::uint32_t>(new_arena.size()), static_cast<std::uint32_t>(form.size())});
+		new_arena += form;
+		deletions(decode_utf8(form), hashes);
+		for (std::uint64_t h : hashes)
+		{
+			filed.emplace_back(h, id);
+		}
+	}
+	if (filed.size() > UINT32_MAX)
+	{
+		return nullptr;
+	}
+	std::sort(filed.begin(), filed.end());
+
+	// About two entries per directory slot
+	std::uint64_t directory_bits = 1;
+	while (directory_bits < 32 && (std::uint64_t(1) << directory_bits) < filed.size() / 2)
+	{
+		++directory_bits;
+	}
+	std::uint64_t n_slots = std::uint64_t(1) << directory_bits;
+	std::vector<std::uint32_t> new_directory(n_slots + 1);
+	std::vector<entry> new_entries(filed.size());
+	std::size_t next = 0;
+	for (std::uint64_t slot = 0; slot <= n_slots; ++slot)
+	{
+		while (next < filed.size() && (filed[next].first >> (64 - directory_bits)) < slot)
+		{
+			++next;
+		}
+		new_directory[slot] = static_cast<std::uint32_t>(next);
+	}
+	for (std::size_t i = 0; i < filed.size(); ++i)
+	{
+		new_entries[i] = {static_cast<std::uint32_t>(filed[i].first), filed[i].second};
+	}
+
+	header h{new_forms.size(), new_arena.size(), new_entries.size(), directory_bits};
+	std::size_t size = sizeof(header) + new_directory.size() * sizeof(std::uint32_t) + new_entries.size() * sizeof(entry) + new_forms.size() * sizeof(form_ref) + new_arena.size();
+
+	deletion_index *index = new deletion_index();
+	index->image_size = size;
+	index->storage.resize((size + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t));
+	char *p = reinterpret_cast<char *>(index->storage.data());
+	std::memcpy(p, &h, sizeof(header));
+	p += sizeof(header);
+	std::memcpy(p, new_directory.data(), new_directory.size() * sizeof(std::uint32_t));
+	p += new_directory.size() * sizeof(std::uint32_t);
+	std::memcpy(p, new_entries.data(), new_entries.size() * sizeof(entry));
+	p += new_entries.size() * sizeof(entry);
+	std::memcpy(p, new_forms.data(), new_forms.size() * sizeof(form_ref));
+	p += new_forms.size() * sizeof(form_ref);
+	std::memcpy(p, new_arena.data(), new_arena.size());
+	index->attach(index->storage.data());
+	return index;
+}
+
+deletion_index *deletion_index::open(const std::filesystem::path &path, const std::filesystem::path &aff_path, const std::filesystem::path &dic_path)
+{
+	std::unique_ptr<mapped_file> file(open_image(path, DELETION_MAGIC, FILE_VERSION, aff_path, dic_path));
+	if (!file || file->size() < image_offset() + sizeof(header))
+	{
+		return nullptr;
+	}
+
+	std::size_t size = file->size() - image_offset();
+	const header *h = reinterpret_cast<const header *>(file->data() + image_offset());
+	if (h->directory_bits == 0 || h->directory_bits > 32)
+	{
+		return nullptr;
+	}
+	std::uint64_t n_slots = std::uint64_t(1) << h->directory_bits;
+	std::uint64_t expected = sizeof(header) + (n_slots + 1) * sizeof(std::uint32_t) + h->n_entries * sizeof(entry) + h->n_forms * sizeof(form_ref) + h->arena_size;
+	if (expected != size || reinterpret_cast<const std::uint32_t *>(h + 1)[n_slots] != h->n_entries)
+	{
+		return nullptr;
+	}
+
+	deletion_index *index = new deletion_index();
+	index->image_size = size;
+	index->attach(h);
+	index->mapping = std::move(file);
+	return index;
+}
+
+bool deletion_index::save(const std::filesystem::path &path, const std::filesystem::path &aff_path, const std::filesystem::path &dic_path) const
+{
+	return save_image(path, DELETION_MAGIC, FILE_VERSION, aff_path, dic_path, hdr, image_size);
+}
+
+std::vector<std::string> deletion_index::nearby(const std::string &word, const word_frequencies *frequencies) const
+{
+	std::u32string target = decode_utf8(word);
+	std::vector<std::uint64_t> hashes;
+	deletions(target, hashes);
+
+	std::vector<std::uint32_t> found;
+	unsigned shift = static_cast<unsigned>(64 - hdr->directory_bits);
+	for (std::uint64_t h : hashes)
+	{
+		std::uint64_t slot = h >> shift;
+		for (std::uint32_t i = directory[slot]; i < directory[slot + 1]; ++i)
+		{
+			if (entries[i].check == static_cast<std::uint32_t>(h))
+			{
+				found.push_back(entries[i].form);
+			}
+		}
+	}
+	std::sort(found.begin(), found.end());
+	found.erase(std::unique(found.begin(), found.end()), found.end());
+
+	std::vector<std::string_view> candidates;
+	for (std::uint32_t f : found)
+	{
+		candidates.emplace_back(arena + forms[f].offset, forms[f].length);
+	}
+
+	// Held until the end, since the candidates view the added words
+	std::shared_lock<std::shared_mutex> lock(additions_mtx);
+	for (std::uint64_t h : hashes)
+	{
+		auto range = added_deletions.equal_range(h);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			candidates.push_back(additions[it->second]);
+		}
+	}
+
+	// Hash collisions and deletions beyond the prefix are weeded out here
+	std::vector<std::tuple<std::size_t, double, std::string, std::string_view>> ranked;
+	for (std::string_view form : candidates)
+	{
+		if (form == word)
+		{
+			continue;
+		}
+		std::size_t distance = edit_distance(target, decode_utf8(form), MAX_DISTANCE);
+		if (distance <= MAX_DISTANCE)
+		{
+			std::string folded;
+			fold_case(form, folded);
+			ranked.emplace_back(distance, frequencies ? -frequencies->score(form) : 0, std::move(folded), form);
+		}
+	}
+	std::sort(ranked.begin(), ranked.end());
+	// An added word may already be in the image, or be found under several deletions
+	ranked.erase(std::unique(ranked.begin(), ranked.end()), ranked.end());
+
+	std::vector<std::string> result;
+	result.reserve(ranked.size());
+	for (const auto &[distance, score, folded, form] : ranked)
+	{
+		result.emplace_back(form);
+	}
+	return result;
+}
+
+void deletion_index::add(const std::string &word)
+{
+	std::vector<std::uint64_t> hashes;
+	deletions(decode_utf8(word), hashes);
+
+	std::unique_lock<std::shared_mutex> lock(additions_mtx);
+	if (std::find(additions.begin(), additions.end(), word) != additions.end())
+	{
+		return;
+	}
+	additions.push_back(word);
+	for (std::uint64_t h : hashes)
+	{
+		added_deletions.emplace(h, static_cast<std::uint32_t>(additions.size() - 1));
+	}
+}
@@ -0,0 +1,747 @@
+#include "sibel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unicode/unistr.h>
+#include <unicode/utf8.h>
+
+static std::u32string decode_utf8(std::string_view s)
+{
+	std::u32string result;
+	int32_t i = 0;
+	int32_t length = static_cast<int32_t>(s.size());
+	while (i < length)
+	{
+		UChar32 c;
+		U8_NEXT(s.data(), i, length, c);
+		result.push_back(c < 0 ? 0xFFFD : c);
+	}
+	return result;
+}
+
+static std::vector<std::string> split_fields(const std::string &line)
+{
+	std::vector<std::string> fields;
+	std::istringstream stream(line);
+	std::string field;
+	while (stream >> field)
+	{
+		if (field[0] == '#')
+		{
+			break;
+		}
+		fields.push_back(field);
+	}
+	return fields;
+}
+
+static void strip_carriage_return(std::string &line)
+{
+	if (!line.empty() && line.back() == '\r')
+	{
+		line.pop_back();
+	}
+}
+
+affix_dictionary::affix_dictionary(const std::filesystem::path &aff_path, const std::filesystem::path &dic_path) : dic_path(dic_path), encoding("UTF-8"), mode(flag_mode::single), need_affix(0), only_in_compound(0), forbidden_word(0), circumfix(0), loaded(false), compounding(false), transforms_input(false)
+{
+	std::ifstream aff(aff_path, std::ios::binary);
+	if (!aff)
+	{
+		return;
+	}
+
+	std::vector<std::string> lines;
+	std::string line;
+	while (std::getline(aff, line))
+	{
+		strip_carriage_return(line);
+		lines.push_back(line);
+	}
+
+	// The encoding has to be known before anything else is decoded
+	for (const std::string &raw : lines)
+	{
+		std::vector<std::string> fields = split_fields(raw);
+		if (fields.size() >= 2 && fields[0] == "SET")
+		{
+			encoding = fields[1];
+			break;
+		}
+	}
+
+	bool in_aliases = false;
+	for (const std::string &raw : lines)
+	{
+		std::vector<std::string> fields = split_fields(to_utf8(raw));
+		if (fields.empty())
+		{
+			continue;
+		}
+		const std::string &directive = fields[0];
+
+		// A directive naming one flag is ignored if its value holds none
+		auto set_flag = [this, &fields](affix_flag &flag)
+		{
+			std::vector<affix_flag> parsed = parse_flags(fields[1]);
+			if (!parsed.empty())
+			{
+				flag = parsed.front();
+			}
+		};
+
+		if (directive == "FLAG" && fields.size() >= 2)
+		{
+			if (fields[1] == "long")
+			{
+				mode = flag_mode::long_pairs;
+			}
+			else if (fields[1] == "num")
+			{
+				mode = flag_mode::numeric;
+			}
+		}
+		else if (directive == "AF" && fields.size() >= 2)
+		{
+			// The first AF line only announces the number of aliases
+			if (!in_aliases)
+			{
+				in_aliases = true;
+			}
+			else
+			{
+				flag_aliases.push_back(parse_flags(fields[1]));
+			}
+		}
+		else if ((directive == "NEEDAFFIX" || directive == "PSEUDOROOT") && fields.size() >= 2)
+		{
+			set_flag(need_affix);
+		}
+		else if (directive == "ONLYINCOMPOUND" && fields.size() >= 2)
+		{
+			set_flag(only_in_compound);
+		}
+		else if (directive == "FORBIDDENWORD" && fields.size() >= 2)
+		{
+			set_flag(forbidden_word);
+		}
+		else if (directive == "CIRCUMFIX" && fields.size() >= 2)
+		{
+			set_flag(circumfix);
+		}
+		else if (directive == "COMPOUNDFLAG" || directive == "COMPOUNDBEGIN" || directive == "COMPOUNDRULE")
+		{
+			compounding = true;
+		}
+		else if (directive == "IGNORE" || directive == "ICONV" || directive == "COMPLEXPREFIXES")
+		{
+			transforms_input = true;
+		}
+		else if ((directive == "PFX" || directive == "SFX") && fields.size() >= 4)
+		{
+			std::unordered_map<affix_flag, affix_class> &classes = directive == "PFX" ? prefixes : suffixes;
+			std::vector<affix_flag> flag = parse_flags(fields[1]);
+			if (flag.empty())
+			{
+				continue;
+			}
+
+			auto it = classes.find(flag.front());
+			if (it == classes.end())
+			{
+				classes[flag.front()] = affix_class{fields[2] == "Y", {}};
+				continue;
+			}
+
+			affix_entry entry;
+			entry.strip = fields[2] == "0" ? "" : fields[2];
+			std::string::size_type slash = fields[3].find('/');
+			entry.append = fields[3].substr(0, slash);
+			if (entry.append == "0")
+			{
+				entry.append.clear();
+			}
+			if (slash != std::string::npos)
+			{
+				entry.continuation = parse_flag_field(std::string_view(fields[3]).substr(slash + 1));
+				std::sort(entry.continuation.begin(), entry.continuation.end());
+			}
+			entry.condition = parse_condition(fields.size() >= 5 ? fields[4] : ".");
+			it->second.entries.push_back(std::move(entry));
+		}
+	}
+
+	loaded = std::filesystem::exists(dic_path);
+}
+
+std::string affix_dictionary::to_utf8(const std::string &line) const
+{
+	if (encoding == "UTF-8" || encoding == "utf-8")
+	{
+		return line;
+	}
+	icu::UnicodeString us(line.data(), static_cast<int32_t>(line.size()), encoding.c_str());
+	std::string result;
+	us.toUTF8String(result);
+	return result;
+}
+
+std::vector<affix_flag> affix_dictionary::parse_flag_field(std::string_view s) const
+{
+	if (flag_aliases.empty() || s.empty() || !std::all_of(s.begin(), s.end(), [](char c) { return c >= '0' && c <= '9'; }))
+	{
+		return parse_flags(s);
+	}
+
+	// Numbered from 1; anything past the last alias, however long, refers to none
+	std::size_t index = 0;
+	for (char c : s)
+	{
+		index = index * 10 + (c - '0');
+		if (index > flag_aliases.size())
+		{
+			return {};
+		}
+	}
+	return index == 0 ? std::vector<affix_flag>() : flag_aliases[index - 1];
+}
+
+std::vector<affix_flag> affix_dictionary::parse_flags(std::string_view s) const
+{
+	std::vector<affix_flag> flags;
+
+	switch (mode)
+	{
+	case flag_mode::numeric:
+	{
+		affix_flag current = 0;
+		bool any = false;
+		for (char c : s)
+		{
+			if (c >= '0' && c <= '9')
+			{
+				current = current * 10 + (c - '0');
+				any = true;
+			}
+			else if (c == ',' && any)
+			{
+				flags.push_back(current);
+				current = 0;
+				any = false;
+			}
+		}
+		if (any)
+		{
+			flags.push_back(current);
+		}
+		break;
+	}
+	case flag_mode::long_pairs:
+	{
+		std::u32string cps = decode_utf8(s);
+		for (std::size_t i = 0; i + 1 < cps.size(); i += 2)
+		{
+			flags.push_back((static_cast<affix_flag>(cps[i]) << 21) | cps[i + 1]);
+		}
+		break;
+	}
+	case flag_mode::single:
+		for (char32_t c : decode_utf8(s))
+		{
+			flags.push_back(c);
+		}
+		break;
+	}
+
+	return flags;
+}
+
+std::vector<affix_dictionary::condition_unit> affix_dictionary::parse_condition(const std::string &s)
+{
+	std::vector<condition_unit> condition;
+	if (s == ".")
+	{
+		return condition;
+	}
+
+	std::u32string cps = decode_utf8(s);
+	for (std::size_t i = 0; i < cps.size(); ++i)
+	{
+		condition_unit unit{false, false, {}};
+		if (cps[i] == U'.')
+		{
+			unit.any = true;
+		}
+		else if (cps[i] == U'[')
+		{
+			++i;
+			if (i < cps.size() && cps[i] == U'^')
+			{
+				unit.negated = true;
+				++i;
+			}
+			for (; i < cps.size() && cps[i] != U']'; ++i)
+			{
+				unit.chars.push_back(cps[i]);
+			}
+		}
+		else
+		{
+			unit.chars.push_back(cps[i]);
+		}
+		condition.push_back(std::move(unit));
+	}
+	return condition;
+}
+
+bool affix_dictionary::matches(const std::vector<condition_unit> &condition, const std::u32string &word, bool at_end)
+{
+	if (condition.size() > word.size())
+	{
+		return false;
+	}
+
+	std::size_t start = at_end ? word.size() - condition.size() : 0;
+	for (std::size_t i = 0; i < condition.size(); ++i)
+	{
+		const condition_unit &unit = condition[i];
+		if (unit.any)
+		{
+			continue;
+		}
+		bool found = std::find(unit.chars.begin(), unit.chars.end(), word[start + i]) != unit.chars.end();
+		if (found == unit.negated)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool affix_dictionary::apply(const affix_entry &entry, const std::string &word, bool is_suffix, std::string &result)
+{
+	if (word.size() < entry.strip.size() || !matches(entry.condition, decode_utf8(word), is_suffix))
+	{
+		return false;
+	}
+
+	if (is_suffix)
+	{
+		if (word.compare(word.size() - entry.strip.size(), entry.strip.size(), entry.strip) != 0)
+		{
+			return false;
+		}
+		result.assign(word, 0, word.size() - entry.strip.size());
+		result += entry.append;
+	}
+	else
+	{
+		if (word.compare(0, entry.strip.size(), entry.strip) != 0)
+		{
+			return false;
+		}
+		result = entry.append;
+		result.append(word, entry.strip.size(), std::string::npos);
+	}
+
+	// A form that strips the whole word is meaningless
+	return !result.empty();
+}
+
+bool affix_dictionary::has_flag(const std::vector<affix_flag> &flags, affix_flag flag)
+{
+	return flag != 0 && std::find(flags.begin(), flags.end(), flag) != flags.end();
+}
+
+bool affix_dictionary::expand(const std::function<void(const std::string &form, bool standalone)> &emit, std::size_t max_forms) const
+{
+	std::ifstream dic(dic_path, std::ios::binary);
+	if (!loaded || !dic)
+	{
+		return false;
+	}
+
+	std::size_t n_forms = 0;
+	auto count = [&](const std::string &form, bool standalone)
+	{
+		emit(form, standalone);
+		return ++n_forms <= max_forms;
+	};
+
+	auto restricted = [this](const std::vector<affix_flag> &flags)
+	{
+		return has_flag(flags, need_affix) || has_flag(flags, only_in_compound) || has_flag(flags, circumfix);
+	};
+
+	struct suffixed_form
+	{
+		std::string form;
+		bool cross_product;
+		bool standalone;
+	};
+
+	std::string line;
+	std::getline(dic, line); // the number of entries
+	while (std::getline(dic, line))
+	{
+		strip_carriage_return(line);
+		line = to_utf8(line);
+		if (line.empty() || line[0] == '\t' || line[0] == '#')
+		{
+			continue;
+		}
+
+		// word[/flags][<whitespace>morphological fields], where '/' may be escaped
+		std::string stem;
+		std::string flag_field;
+		std::string::size_type i = 0;
+		for (; i < line.size(); ++i)
+		{
+			if (line[i] == '\\' && i + 1 < line.size() && line[i + 1] == '/')
+			{
+				stem += '/';
+				++i;
+			}
+			else if (line[i] == '/' || line[i] == '\t' || (line[i] == ' ' && line.find(':', i) == i + 3))
+			{
+				break;
+			}
+			else
+			{
+				stem += line[i];
+			}
+		}
+		if (i < line.size() && line[i] == '/')
+		{
+			std::string::size_type end = line.find_first_of(" \t", i + 1);
+			flag_field = line.substr(i + 1, end == std::string::npos ? std::string::npos : end - i - 1);
+		}
+		while (!stem.empty() && stem.back() == ' ')
+		{
+			stem.pop_back();
+		}
+		if (stem.empty())
+		{
+			continue;
+		}
+
+		std::vector<affix_flag> flags = parse_flag_field(flag_field);
+		if (has_flag(flags, forbidden_word))
+		{
+			continue;
+		}
+
+		if (!count(stem, !has_flag(flags, need_affix) && !has_flag(flags, only_in_compound)))
+		{
+			return false;
+		}
+
+		std::vector<affix_flag> prefix_flags(flags);
+		std::string form;
+		std::string form2;
+
+		// The forms made by the suffixes among suffix_flags and the twofold suffixes they
+		// allow, with the flags their continuation classes hand on to prefixes
+		auto add_suffixes = [&](const std::vector<affix_flag> &suffix_flags, std::vector<suffixed_form> &into, std::vector<affix_flag> *continuations)
+		{
+			for (affix_flag flag : suffix_flags)
+			{
+				auto sfx = suffixes.find(flag);
+				if (sfx == suffixes.end())
+				{
+					continue;
+				}
+				for (const affix_entry &entry : sfx->second.entries)
+				{
+					if (!apply(entry, stem, true, form))
+					{
+						continue;
+					}
+					into.push_back({form, sfx->second.cross_product, !restricted(entry.continuation)});
+					if (continuations)
+					{
+						continuations->insert(continuations->end(), entry.continuation.begin(), entry.continuation.end());
+					}
+
+					// Twofold suffixes
+					for (affix_flag inner : entry.continuation)
+					{
+						auto sfx2 = suffixes.find(inner);
+						if (sfx2 == suffixes.end())
+						{
+							continue;
+						}
+						for (const affix_entry &entry2 : sfx2->second.entries)
+						{
+							if (apply(entry2, form, true, form2))
+							{
+								into.push_back({form2, sfx->second.cross_product && sfx2->second.cross_product, !restricted(entry2.continuation)});
+							}
+						}
+					}
+				}
+			}
+		};
+
+		std::vector<suffixed_form> suffixed;
+		add_suffixes(flags, suffixed, &prefix_flags);
+		for (const suffixed_form &s : suffixed)
+		{
+			if (!count(s.form, s.standalone))
+			{
+				return false;
+			}
+		}
+
+		std::sort(prefix_flags.begin(), prefix_flags.end());
+		prefix_flags.erase(std::unique(prefix_flags.begin(), prefix_flags.end()), prefix_flags.end());
+		std::vector<affix_flag> prefix_suffixes;
+		std::vector<suffixed_form> prefix_suffixed;
+		for (affix_flag flag : prefix_flags)
+		{
+			auto pfx = prefixes.find(flag);
+			if (pfx == prefixes.end())
+			{
+				continue;
+			}
+			for (const affix_entry &entry : pfx->second.entries)
+			{
+				bool standalone = !restricted(entry.continuation);
+				if (apply(entry, stem, false, form) && !count(form, standalone))
+				{
+					return false;
+				}
+				if (!pfx->second.cross_product)
+				{
+					continue;
+				}
+
+				// Suffixes the stem only takes after this prefix, through its continuation class
+				prefix_suffixes.clear();
+				for (affix_flag inner : entry.continuation)
+				{
+					if (!has_flag(flags, inner))
+					{
+						prefix_suffixes.push_back(inner);
+					}
+				}
+				prefix_suffixed.clear();
+				add_suffixes(prefix_suffixes, prefix_suffixed, nullptr);
+
+				for (const std::vector<suffixed_form> *forms : {&suffixed, &prefix_suffixed})
+				{
+					for (const suffixed_form &s : *forms)
+					{
+						if (s.cross_product && apply(entry, s.form, false, form2) && !count(form2, standalone && s.standalone))
+						{
+							return false;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+const std::size_t prefix_filter::MAX_FORMS = 50000000;
+const std::uint32_t prefix_filter::FILE_VERSION = 2;
+
+static const char FILTER_MAGIC[8] = {'S', 'I', 'B', 'E', 'L', 'P', 'F', 'X'};
+
+prefix_filter::prefix_filter() : image_size(0), hdr(nullptr), offsets(nullptr), arena(nullptr) {}
+
+prefix_filter::~prefix_filter() = default;
+
+void prefix_filter::attach(const void *image)
+{
+	hdr = static_cast<const header *>(image);
+	offsets = reinterpret_cast<const std::uint32_t *>(hdr + 1);
+	arena = reinterpret_cast<const char *>(offsets + hdr->n_forms + 1);
+}
+
+prefix_filter *prefix_filter::build(const affix_dictionary &dictionary)
+{
+	if (!dictionary.loaded || dictionary.transforms_input)
+	{
+		return nullptr;
+	}
+
+	std::string raw;
+	std::vector<std::uint32_t> raw_offsets;
+	std::string folded;
+	bool complete = dictionary.expand([&](const std::string &form, bool)
+	{
+		fold_case(form, folded);
+		raw_offsets.push_back(static_cast<std::uint32_t>(raw.size()));
+		raw += folded;
+	}, MAX_FORMS);
+	if (!complete || raw.size() > UINT32_MAX / 2)
+	{
+		return nullptr;
+	}
+	raw_offsets.push_back(static_cast<std::uint32_t>(raw.size()));
+
+	std::vector<std::uint32_t> order(raw_offsets.size() - 1);
+	for (std::uint32_t i = 0; i < order.size(); ++i)
+	{
+		order[i] = i;
+	}
+	auto raw_form = [&](std::uint32_t i)
+	{
+		return std::string_view(raw).substr(raw_offsets[i], raw_offsets[i + 1] - raw_offsets[i]);
+	};
+	std::sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b)
+	{
+		return raw_form(a) < raw_form(b);
+	});
+
+	std::string new_arena;
+	std::vector<std::uint32_t> new_offsets{0};
+	for (std::size_t i = 0; i < order.size(); ++i)
+	{
+		if (i > 0 && raw_form(order[i]) == raw_form(order[i - 1]))
+		{
+			continue;
+		}
+		new_arena += raw_form(order[i]);
+		new_offsets.push_back(static_cast<std::uint32_t>(new_arena.size()));
+	}
+
+	header h{new_offsets.size() - 1, new_arena.size(), dictionary.compounding};
+	std::size_t size = sizeof(header) + new_offsets.size() * sizeof(std::uint32_t) + new_arena.size();
+
+	prefix_filter *filter = new prefix_filter();
+	filter->image_size = size;
+	filter->storage.resize((size + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t));
+	char *p = reinterpret_cast<char *>(filter->storage.data());
+	std::memcpy(p, &h, sizeof(header));
+	p += sizeof(header);
+	std::memcpy(p, new_offsets.data(), new_offsets.size() * sizeof(std::uint32_t));
+	p += new_offsets.size() * sizeof(std::uint32_t);
+	std::memcpy(p, new_arena.data(), new_arena.size());
+	filter->attach(filter->storage.data());
+	return filter;
+}
+
+prefix_filter *prefix_filter::open(const std::filesystem::path &path, const std::filesystem::path &aff_path, const std::filesystem::path &dic_path)
+{
+	std::unique_ptr<mapped_file> file(open_image(path, FILTER_MAGIC, FILE_VERSION, aff_path, dic_path));
+	if (!file || file->size() < image_offset() + sizeof(header))
+	{
+		return nullptr;
+	}
+
+	std::size_t size = file->size() - image_offset();
+	const header *h = reinterpret_cast<const header *>(file->data() + image_offset());
+	if (sizeof(header) + (h->n_forms + 1) * sizeof(std::uint32_t) + h->arena_size != size)
+	{
+		return nullptr;
+	}
+
+	prefix_filter *filter = new prefix_filter();
+	filter->image_size = size;
+	filter->attach(h);
+	filter->mapping = std::move(file);
+	return filter;
+}
+
+bool prefix_filter::save(const std::filesystem::path &path, const std::filesystem::path &aff_path, const std::filesystem::path &dic_path) const
+{
+	return save_image(path, FILTER_MAGIC, FILE_VERSION, aff_path, dic_path, hdr, image_size);
+}
+
+std::string_view prefix_filter::form(std::size_t i) const
+{
+	return std::string_view(arena + offsets[i], offsets[i + 1] - offsets[i]);
+}
+
+std::size_t prefix_filter::lower_bound(std::string_view key) const
+{
+	std::size_t low = 0;
+	std::size_t high = hdr->n_forms;
+	while (low < high)
+	{
+		std::size_t mid = low + (high - low) / 2;
+		if (form(mid) < key)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+	return low;
+}
+
+bool prefix_filter::has_prefix(std::string_view folded) const
+{
+	std::size_t i = lower_bound(folded);
+	if (i < hdr->n_forms && form(i).substr(0, folded.size()) == folded)
+	{
+		return true;
+	}
+
+	std::shared_lock<std::shared_mutex> lock(additions_mtx);
+	return std::any_of(additions.begin(), additions.end(), [folded](const std::string &word)
+	{
+		return std::string_view(word).substr(0, folded.size()) == folded;
+	});
+}
+
+bool prefix_filter::contains(std::string_view folded) const
+{
+	std::size_t i = lower_bound(folded);
+	if (i < hdr->n_forms && form(i) == folded)
+	{
+		return true;
+	}
+
+	std::shared_lock<std::shared_mutex> lock(additions_mtx);
+	return std::find(additions.begin(), additions.end(), folded) != additions.end();
+}
+
+bool prefix_filter::viable_folded(std::string_view folded, int depth) const
+{
+	if (has_prefix(folded))
+	{
+		return true;
+	}
+	if (!hdr->compounding || depth == 0)
+	{
+		return false;
+	}
+
+	// The prefix might run from a complete word into the next part of a compound
+	for (std::size_t split = 1; split < folded.size(); ++split)
+	{
+		if (U8_IS_TRAIL(folded[split]))
+		{
+			continue;
+		}
+		if (contains(folded.substr(0, split)) && viable_folded(folded.substr(split), depth - 1))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool prefix_filter::viable(const std::string &prefix) const
+{
+	thread_local std::string folded;
+	fold_case(prefix, folded);
+	return viable_folded(folded, 8);
+}
+
+void prefix_filter::add(const std::string &word)
+{
+	std::string folded;
+	fold_case(word, folded);
+	std::unique_lock<std::shared_mutex> lock(additions_mtx);
+	additions.push_back(std::move(folded));
+}
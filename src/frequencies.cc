@@ -0,0 +1,197 @@
+#include "sibel.h"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <unordered_map>
+
+const std::uint32_t word_frequencies::FILE_VERSION = 1;
+
+static const char FREQUENCIES_MAGIC[8] = {'S', 'I', 'B', 'E', 'L', 'F', 'R', 'Q'};
+
+word_frequencies::word_frequencies() : image_size(0), hdr(nullptr), buckets(nullptr), entries(nullptr), arena(nullptr) {}
+
+void word_frequencies::attach(const void *image)
+{
+	hdr = static_cast<const header *>(image);
+	buckets = reinterpret_cast<const std::uint32_t *>(hdr + 1);
+	entries = reinterpret_cast<const entry *>(buckets + hdr->n_buckets);
+	arena = reinterpret_cast<const char *>(entries + hdr->n_words);
+}
+
+word_frequencies *word_frequencies::build(const std::filesystem::path &path, std::string &error)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		error = "Cannot open " + path.u8string();
+		return nullptr;
+	}
+
+	std::unordered_map<std::string, double> scores;
+	std::string line;
+	std::size_t line_number = 0;
+	while (std::getline(file, line))
+	{
+		++line_number;
+		std::size_t word_start = line.find_first_not_of(" \t\r");
+		if (word_start == std::string::npos)
+		{
+			continue;
+		}
+		std::size_t word_end = line.find_first_of(" \t\r", word_start);
+		std::string word = line.substr(word_start, word_end == std::string::npos ? std::string::npos : word_end - word_start);
+
+		// Uncounted words only come after the counted ones, in their order
+		double score = -static_cast<double>(line_number);
+		if (word_end != std::string::npos)
+		{
+			const char *count = line.c_str() + word_end;
+			char *end;
+			double value = std::strtod(count, &end);
+			if (end != count && std::isfinite(value) && value >= 0)
+			{
+				score = value;
+			}
+		}
+
+		auto [it, inserted] = scores.emplace(std::move(word), score);
+		if (!inserted)
+		{
+			it->second = std::max(it->second, score);
+		}
+	}
+	if (scores.size() > UINT32_MAX)
+	{
+		error = path.u8string() + " has too many words";
+		return nullptr;
+	}
+
+	std::vector<entry> new_entries;
+	std::string new_arena;
+	for (const auto &[word, score] : scores)
+	{
+		new_entries.push_back({static_cast<std::uint32_t>(new_arena.size()), static_cast<std::uint32_t>(word.size()), score});
+		new_arena += word;
+		if (new_arena.size() > UINT32_MAX)
+		{
+			error = path.u8string() + " is too large";
+			return nullptr;
+		}
+	}
+
+	// At least two buckets, so that the entries after them stay aligned
+	std::uint64_t n_buckets = 2;
+	while (n_buckets < 2 * new_entries.size())
+	{
+		n_buckets *= 2;
+	}
+	std::vector<std::uint32_t> new_buckets(n_buckets, 0);
+	for (std::uint32_t i = 0; i < new_entries.size(); ++i)
+	{
+		std::uint64_t b = orthographic_index::hash(std::string_view(new_arena).substr(new_entries[i].offset, new_entries[i].length)) & (n_buckets - 1);
+		while (new_buckets[b] != 0)
+		{
+			b = (b + 1) & (n_buckets - 1);
+		}
+		new_buckets[b] = i + 1;
+	}
+
+	header h{n_buckets, new_entries.size(), new_arena.size()};
+	std::size_t size = sizeof(header) + n_buckets * sizeof(std::uint32_t) + new_entries.size() * sizeof(entry) + new_arena.size();
+
+	word_frequencies *frequencies = new word_frequencies();
+	frequencies->image_size = size;
+	frequencies->storage.resize((size + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t));
+	char *p = reinterpret_cast<char *>(frequencies->storage.data());
+	std::memcpy(p, &h, sizeof(header));
+	p += sizeof(header);
+	std::memcpy(p, new_buckets.data(), n_buckets * sizeof(std::uint32_t));
+	p += n_buckets * sizeof(std::uint32_t);
+	std::memcpy(p, new_entries.data(), new_entries.size() * sizeof(entry));
+	p += new_entries.size() * sizeof(entry);
+	std::memcpy(p, new_arena.data(), new_arena.size());
+	frequencies->attach(frequencies->storage.data());
+	return frequencies;
+}
+
+word_frequencies *word_frequencies::open(const std::filesystem::path &path, const std::filesystem::path &list_path)
+{
+	// The list is the only source of the image, so it stands for both files of the fingerprint
+	std::unique_ptr<mapped_file> file(open_image(path, FREQUENCIES_MAGIC, FILE_VERSION, list_path, list_path));
+	if (!file || file->size() < image_offset() + sizeof(header))
+	{
+		return nullptr;
+	}
+
+	std::size_t size = file->size() - image_offset();
+	const header *h = reinterpret_cast<const header *>(file->data() + image_offset());
+	std::uint64_t expected = sizeof(header) + h->n_buckets * sizeof(std::uint32_t) + h->n_words * sizeof(entry) + h->arena_size;
+	if (expected != size || h->n_buckets < 2 || (h->n_buckets & (h->n_buckets - 1)) != 0)
+	{
+		return nullptr;
+	}
+
+	word_frequencies *frequencies = new word_frequencies();
+	frequencies->image_size = size;
+	frequencies->attach(h);
+	frequencies->mapping = std::move(file);
+	return frequencies;
+}
+
+bool word_frequencies::save(const std::filesystem::path &path, const std::filesystem::path &list_path) const
+{
+	return save_image(path, FREQUENCIES_MAGIC, FILE_VERSION, list_path, list_path, hdr, image_size);
+}
+
+const word_frequencies::entry *word_frequencies::find(std::string_view word) const
+{
+	std::uint64_t mask = hdr->n_buckets - 1;
+	for (std::uint64_t b = orthographic_index::hash(word) & mask; buckets[b] != 0; b = (b + 1) & mask)
+	{
+		const entry &e = entries[buckets[b] - 1];
+		if (std::string_view(arena + e.offset, e.length) == word)
+		{
+			return &e;
+		}
+	}
+	return nullptr;
+}
+
+double word_frequencies::score(std::string_view word) const
+{
+	if (const entry *e = find(word))
+	{
+		return e->score;
+	}
+
+	thread_local std::string folded;
+	fold_case(word, folded);
+	if (folded != word)
+	{
+		if (const entry *e = find(folded))
+		{
+			return e->score;
+		}
+	}
+	return -std::numeric_limits<double>::infinity();
+}
+
+void word_frequencies::rank(std::vector<std::string> &words) const
+{
+	std::vector<std::pair<double, std::size_t>> order(words.size());
+	for (std::size_t i = 0; i < words.size(); ++i)
+	{
+		order[i] = {-score(words[i]), i};
+	}
+	std::sort(order.begin(), order.end());
+
+	std::vector<std::string> ranked;
+	ranked.reserve(words.size());
+	for (const auto &[score, i] : order)
+	{
+		ranked.push_back(std::move(words[i]));
+	}
+	words = std::move(ranked);
+}
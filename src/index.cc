@@ -0,0 +1,293 @@
+#include "sibel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unicode/uchar.h>
+#include <unicode/unistr.h>
+#include <unicode/utf8.h>
+
+const std::size_t orthographic_index::MAX_FORMS = 50000000;
+const std::uint32_t orthographic_index::FILE_VERSION = 3;
+
+static const char INDEX_MAGIC[8] = {'S', 'I', 'B', 'E', 'L', 'I', 'D', 'X'};
+
+orthographic_index::orthographic_index() : image_size(0), hdr(nullptr), buckets(nullptr), entries(nullptr), forms(nullptr), arena(nullptr) {}
+
+std::uint64_t orthographic_index::hash(std::string_view s)
+{
+	// FNV-1a
+	std::uint64_t h = 0xcbf29ce484222325ULL;
+	for (unsigned char c : s)
+	{
+		h ^= c;
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+void orthographic_index::attach(const void *image)
+{
+	hdr = static_cast<const header *>(image);
+	buckets = reinterpret_cast<const std::uint32_t *>(hdr + 1);
+	entries = reinterpret_cast<const entry *>(buckets + hdr->n_buckets);
+	forms = reinterpret_cast<const form_ref *>(entries + hdr->n_entries);
+	arena = reinterpret_cast<const char *>(forms + hdr->n_forms);
+}
+
+orthographic_index *orthographic_index::build(const affix_dictionary &dictionary)
+{
+	// (key, form) pairs, both stored in one scratch arena
+	std::string raw;
+	std::string key;
+	std::vector<std::uint32_t> raw_offsets;
+	bool complete = dictionary.expand([&](const std::string &form, bool)
+	{
+		if (!is_without_banned_chars(form))
+		{
+			return;
+		}
+		raw_offsets.push_back(static_cast<std::uint32_t>(raw.size()));
+		simplify(form, key);
+		raw += key;
+		raw_offsets.push_back(static_cast<std::uint32_t>(raw.size()));
+		raw += form;
+	}, MAX_FORMS);
+	if (!complete || raw.size() > UINT32_MAX / 2)
+	{
+		return nullptr;
+	}
+	raw_offsets.push_back(static_cast<std::uint32_t>(raw.size()));
+
+	auto raw_string = [&](std::size_t i)
+	{
+		return std::string_view(raw).substr(raw_offsets[i], raw_offsets[i + 1] - raw_offsets[i]);
+	};
+
+	std::vector<std::uint32_t> pairs((raw_offsets.size() - 1) / 2);
+	for (std::uint32_t i = 0; i < pairs.size(); ++i)
+	{
+		pairs[i] = 2 * i;
+	}
+	std::sort(pairs.begin(), pairs.end(), [&](std::uint32_t a, std::uint32_t b)
+	{
+		int c = raw_string(a).compare(raw_string(b));
+		return c < 0 || (c == 0 && raw_string(a + 1) < raw_string(b + 1));
+	});
+	pairs.erase(std::unique(pairs.begin(), pairs.end(), [&](std::uint32_t a, std::uint32_t b)
+	{
+		return raw_string(a) == raw_string(b) && raw_string(a + 1) == raw_string(b + 1);
+	}), pairs.end());
+
+	std::vector<entry> new_entries;
+	std::vector<form_ref> new_forms;
+	std::string new_arena;
+	for (std::size_t i = 0; i < pairs.size(); ++i)
+	{
+		std::string_view key = raw_string(pairs[i]);
+		std::string_view form = raw_string(pairs[i] + 1);
+		if (i == 0 || key != raw_string(pairs[i - 1]))
+		{
+			new_entries.push_back({static_cast<std::uint32_t>(new_arena.size()), static_cast<std::uint32_t>(key.size()), static_cast<std::uint32_t>(new_forms.size()), 0});
+			new_arena += key;
+		}
+
+		entry &e = new_entries.back();
+		++e.n_forms;
+		// Most keys are also one of their forms, in which case the bytes are shared
+		if (form == key)
+		{
+			new_forms.push_back({e.key_offset, e.key_length});
+		}
+		else
+		{
+			new_forms.push_back({static_cast<std::uint32_t>(new_arena.size()), static_cast<std::uint32_t>(form.size())});
+			new_arena += form;
+		}
+	}
+
+	std::uint64_t n_buckets = 1;
+	while (n_buckets < 2 * new_entries.size())
+	{
+		n_buckets *= 2;
+	}
+	std::vector<std::uint32_t> new_buckets(n_buckets, 0);
+	for (std::uint32_t i = 0; i < new_entries.size(); ++i)
+	{
+		std::uint64_t b = hash(std::string_view(new_arena).substr(new_entries[i].key_offset, new_entries[i].key_length)) & (n_buckets - 1);
+		while (new_buckets[b] != 0)
+		{
+			b = (b + 1) & (n_buckets - 1);
+		}
+		new_buckets[b] = i + 1;
+	}
+
+	header h{n_buckets, new_entries.size(), new_forms.size(), new_arena.size(), !dictionary.compounding && !dictionary.transforms_input};
+	std::size_t size = sizeof(header) + n_buckets * sizeof(std::uint32_t) + new_entries.size() * sizeof(entry) + new_forms.size() * sizeof(form_ref) + new_arena.size();
+
+	orthographic_index *index = new orthographic_index();
+	index->image_size = size;
+	index->storage.resize((size + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t));
+	char *p = reinterpret_cast<char *>(index->storage.data());
+	std::memcpy(p, &h, sizeof(header));
+	p += sizeof(header);
+	std::memcpy(p, new_buckets.data(), n_buckets * sizeof(std::uint32_t));
+	p += n_buckets * sizeof(std::uint32_t);
+	std::memcpy(p, new_entries.data(), new_entries.size() * sizeof(entry));
+	p += new_entries.size() * sizeof(entry);
+	std::memcpy(p, new_forms.data(), new_forms.size() * sizeof(form_ref));
+	p += new_forms.size() * sizeof(form_ref);
+	std::memcpy(p, new_arena.data(), new_arena.size());
+	index->attach(index->storage.data());
+	return index;
+}
+
+orthographic_index *orthographic_index::open(const std::filesystem::path &path, const std::filesystem::path &aff_path, const std::filesystem::path &dic_path)
+{
+	std::unique_ptr<mapped_file> file(open_image(path, INDEX_MAGIC, FILE_VERSION, aff_path, dic_path));
+	if (!file || file->size() < image_offset() + sizeof(header))
+	{
+		return nullptr;
+	}
+
+	std::size_t size = file->size() - image_offset();
+	const header *h = reinterpret_cast<const header *>(file->data() + image_offset());
+	std::uint64_t expected = sizeof(header) + h->n_buckets * sizeof(std::uint32_t) + h->n_entries * sizeof(entry) + h->n_forms * sizeof(form_ref) + h->arena_size;
+	if (expected != size || h->n_buckets == 0 || (h->n_buckets & (h->n_buckets - 1)) != 0)
+	{
+		return nullptr;
+	}
+
+	orthographic_index *index = new orthographic_index();
+	index->image_size = size;
+	index->attach(h);
+	index->mapping = std::move(file);
+	return index;
+}
+
+bool orthographic_index::save(const std::filesystem::path &path, const std::filesystem::path &aff_path, const std::filesystem::path &dic_path) const
+{
+	return save_image(path, INDEX_MAGIC, FILE_VERSION, aff_path, dic_path, hdr, image_size);
+}
+
+void orthographic_index::lookup(std::string_view key, const std::function<void(std::string_view)> &emit) const
+{
+	std::uint64_t mask = hdr->n_buckets - 1;
+	for (std::uint64_t b = hash(key) & mask; buckets[b] != 0; b = (b + 1) & mask)
+	{
+		const entry &e = entries[buckets[b] - 1];
+		if (std::string_view(arena + e.key_offset, e.key_length) == key)
+		{
+			for (std::uint32_t i = e.first_form; i < e.first_form + e.n_forms; ++i)
+			{
+				emit(std::string_view(arena + forms[i].offset, forms[i].length));
+			}
+			break;
+		}
+	}
+
+	std::shared_lock<std::shared_mutex> lock(additions_mtx);
+	if (!additions.empty())
+	{
+		auto range = additions.equal_range(std::string(key));
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			emit(it->second);
+		}
+	}
+}
+
+bool orthographic_index::exhaustive() const
+{
+	return hdr->exhaustive;
+}
+
+void orthographic_index::add(const std::string &word)
+{
+	if (is_without_banned_chars(word))
+	{
+		std::string key(simplify(word));
+		std::unique_lock<std::shared_mutex> lock(additions_mtx);
+		additions.emplace(std::move(key), word);
+	}
+}
+
+static std::string capitalise(std::string_view s)
+{
+	int32_t i = 0;
+	UChar32 c;
+	U8_NEXT(s.data(), i, static_cast<int32_t>(s.size()), c);
+	if (c < 0)
+	{
+		return std::string(s);
+	}
+
+	std::string result;
+	icu::UnicodeString(static_cast<UChar32>(u_totitle(c))).toUTF8String(result);
+	result.append(s.substr(i));
+	return result;
+}
+
+static std::string upper_case(std::string_view s)
+{
+	std::string result;
+	icu::UnicodeString::fromUTF8(icu::StringPiece(s.data(), static_cast<int32_t>(s.size()))).toUpper().toUTF8String(result);
+	return result;
+}
+
+std::vector<std::string> orthographic_index::candidates(const std::string &word) const
+{
+	std::vector<std::string> result;
+	auto add = [&result](std::string &&form)
+	{
+		if (std::find(result.begin(), result.end(), form) == result.end())
+		{
+			result.push_back(std::move(form));
+		}
+	};
+
+	std::string key(simplify(word));
+	lookup(key, [&](std::string_view form)
+	{
+		add(std::string(form));
+	});
+
+	bool has_lower = std::any_of(key.begin(), key.end(), [](unsigned char c) { return c >= 'a' && c <= 'z'; });
+	bool first_upper = !key.empty() && key[0] >= 'A' && key[0] <= 'Z';
+	if (!first_upper)
+	{
+		return result;
+	}
+
+	std::string lower(key);
+	std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c)
+	{
+		return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+	});
+
+	if (has_lower)
+	{
+		// Capitalised at the start of a sentence
+		std::string lower_first(key);
+		lower_first[0] = lower[0];
+		lookup(lower_first, [&](std::string_view form)
+		{
+			add(capitalise(form));
+		});
+	}
+	else if (key.size() > 1)
+	{
+		// Written in capitals
+		lookup(lower, [&](std::string_view form)
+		{
+			add(upper_case(form));
+		});
+		std::string capitalised(lower);
+		capitalised[0] = key[0];
+		lookup(capitalised, [&](std::string_view form)
+		{
+			add(upper_case(form));
+		});
+	}
+
+	return result;
+}
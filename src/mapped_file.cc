@@ -0,0 +1,234 @@
+#include "sibel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::uint64_t checksum(const void *data, std::size_t size)
+{
+	// Word-at-a-time multiplicative hash; not cryptographic, only meant to catch damaged files
+	const unsigned char *p = static_cast<const unsigned char *>(data);
+	std::uint64_t h = 0x9E3779B97F4A7C15ULL ^ size;
+	std::size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		std::uint64_t w;
+		std::memcpy(&w, p + i, 8);
+		h = (h ^ w) * 0xFF51AFD7ED558CCDULL;
+		h ^= h >> 32;
+	}
+	for (; i < size; ++i)
+	{
+		h = (h ^ p[i]) * 0x100000001B3ULL;
+	}
+	return h;
+}
+
+mapped_file::mapped_file(void *address, std::size_t length) : address(address), length(length) {}
+
+mapped_file::~mapped_file()
+{
+	if (length > 0)
+	{
+		munmap(address, length);
+	}
+}
+
+mapped_file *mapped_file::open(const std::filesystem::path &path)
+{
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return nullptr;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return nullptr;
+	}
+
+	void *address = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (address == MAP_FAILED)
+	{
+		return nullptr;
+	}
+	return new mapped_file(address, st.st_size);
+}
+
+const char *mapped_file::data() const
+{
+	return static_cast<const char *>(address);
+}
+
+std::size_t mapped_file::size() const
+{
+	return length;
+}
+
+void mapped_file::advise(std::size_t offset, std::size_t size, advice a) const
+{
+	static const std::size_t page_size = sysconf(_SC_PAGESIZE);
+	std::size_t begin = offset / page_size * page_size;
+	std::size_t end = std::min(offset + size, length);
+	if (begin >= end)
+	{
+		return;
+	}
+
+	int flag = a == advice::sequential ? MADV_SEQUENTIAL : a == advice::will_need ? MADV_WILLNEED : MADV_DONTNEED;
+	madvise(static_cast<char *>(address) + begin, end - begin, flag);
+}
+
+bool write_file_atomically(const std::filesystem::path &path, const std::vector<std::string_view> &parts)
+{
+	std::error_code ec;
+	std::filesystem::create_directories(path.parent_path(), ec);
+
+	// Spellers built at once in one process may write the same file from several threads
+	static std::atomic<std::uint64_t> n_written(0);
+	std::filesystem::path tmp_path(path);
+	tmp_path += ".tmp" + std::to_string(getpid()) + "." + std::to_string(n_written++);
+	{
+		std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+		for (std::string_view part : parts)
+		{
+			out.write(part.data(), part.size());
+		}
+		if (!out.flush())
+		{
+			out.close();
+			std::filesystem::remove(tmp_path, ec);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(tmp_path, path, ec);
+	if (ec)
+	{
+		std::filesystem::remove(tmp_path, ec);
+		return false;
+	}
+	return true;
+}
+
+static bool stat_file(const std::filesystem::path &path, std::uint64_t &size, std::uint64_t &mtime)
+{
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+	{
+		return false;
+	}
+	size = st.st_size;
+	mtime = static_cast<std::uint64_t>(st.st_mtim.tv_sec) * 1000000000ULL + st.st_mtim.tv_nsec;
+	return true;
+}
+
+static std::uint64_t hash_file(const std::filesystem::path &path)
+{
+	std::unique_ptr<mapped_file> file(mapped_file::open(path));
+	return file ? checksum(file->data(), file->size()) : 0;
+}
+
+dictionary_fingerprint dictionary_fingerprint::of(const std::filesystem::path &aff_path, const std::filesystem::path &dic_path)
+{
+	dictionary_fingerprint fp{};
+	stat_file(aff_path, fp.aff_size, fp.aff_mtime);
+	stat_file(dic_path, fp.dic_size, fp.dic_mtime);
+	fp.aff_hash = hash_file(aff_path);
+	fp.dic_hash = hash_file(dic_path);
+	return fp;
+}
+
+bool dictionary_fingerprint::is_current(const std::filesystem::path &aff_path, const std::filesystem::path &dic_path) const
+{
+	dictionary_fingerprint now{};
+	if (!stat_file(aff_path, now.aff_size, now.aff_mtime) || !stat_file(dic_path, now.dic_size, now.dic_mtime))
+	{
+		return false;
+	}
+	if (now.aff_size != aff_size || now.dic_size != dic_size)
+	{
+		return false;
+	}
+	if (now.aff_mtime == aff_mtime && now.dic_mtime == dic_mtime)
+	{
+		return true;
+	}
+	return hash_file(aff_path) == aff_hash && hash_file(dic_path) == dic_hash;
+}
+
+struct image_file_header
+{
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t reserved;
+	dictionary_fingerprint source;
+	std::uint64_t payload_size;
+	std::uint64_t payload_checksum;
+};
+
+std::size_t image_offset()
+{
+	return sizeof(image_file_header);
+}
+
+bool save_image(const std::filesystem::path &path, const char (&magic)[8], std::uint32_t version, const std::filesystem::path &aff_path, const std::filesystem::path &dic_path, const void *image, std::size_t size)
+{
+	image_file_header fh{};
+	std::memcpy(fh.magic, magic, sizeof(fh.magic));
+	fh.version = version;
+	fh.source = dictionary_fingerprint::of(aff_path, dic_path);
+	fh.payload_size = size;
+	fh.payload_checksum = checksum(image, size);
+
+	if (!write_file_atomically(path, {
+		std::string_view(reinterpret_cast<const char *>(&fh), sizeof(fh)),
+		std::string_view(static_cast<const char *>(image), size)
+	}))
+	{
+		return false;
+	}
+
+	// The payload is checked once here rather than on every open, which would read every page
+	std::unique_ptr<mapped_file> written(mapped_file::open(path));
+	if (!written || written->size() != sizeof(fh) + size || checksum(written->data() + sizeof(fh), size) != fh.payload_checksum)
+	{
+		std::error_code ec;
+		std::filesystem::remove(path, ec);
+		return false;
+	}
+	return true;
+}
+
+mapped_file *open_image(const std::filesystem::path &path, const char (&magic)[8], std::uint32_t version, const std::filesystem::path &aff_path, const std::filesystem::path &dic_path)
+{
+	std::unique_ptr<mapped_file> file(mapped_file::open(path));
+	if (!file || file->size() < sizeof(image_file_header))
+	{
+		return nullptr;
+	}
+
+	const image_file_header *fh = reinterpret_cast<const image_file_header *>(file->data());
+	if (std::memcmp(fh->magic, magic, sizeof(fh->magic)) != 0 || fh->version != version || fh->payload_size != file->size() - sizeof(image_file_header))
+	{
+		return nullptr;
+	}
+	if (!fh->source.is_current(aff_path, dic_path))
+	{
+		return nullptr;
+	}
+#ifdef SIBEL_VERIFY_IMAGES
+	if (checksum(file->data() + sizeof(image_file_header), fh->payload_size) != fh->payload_checksum)
+	{
+		return nullptr;
+	}
+#endif
+	return file.release();
+}
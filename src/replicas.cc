@@ -0,0 +1,189 @@
+#include "sibel.h"
+
+backend_replicas::backend_replicas(backend_loader load, std::size_t n, bool lazy) : make_replica(std::move(load)), replicas(n), busy(n, false), loaded(n, false), replayed(n, 0), history_start(0)
+{
+	if (lazy)
+	{
+		return;
+	}
+
+	// Loading is the slow part, so the replicas are loaded in parallel
+	task_group group;
+	for (std::unique_ptr<spelling_backend> &replica : replicas)
+	{
+		group.run([&]
+		{
+			replica = make_replica();
+		});
+	}
+	group.wait();
+	loaded.assign(n, true);
+}
+
+backend_replicas::~backend_replicas() = default;
+
+std::size_t backend_replicas::size() const
+{
+	return replicas.size();
+}
+
+/**
+ * A free replica, preferring loaded ones so that no more are loaded than are needed
+ * at once, or size() if there is none. Called with mtx held.
+ */
+std::size_t backend_replicas::free_replica(bool may_load) const
+{
+	std::size_t unloaded = busy.size();
+	for (std::size_t i = 0; i < busy.size(); ++i)
+	{
+		if (!busy[i] && loaded[i])
+		{
+			return i;
+		}
+		if (!busy[i] && unloaded == busy.size())
+		{
+			unloaded = i;
+		}
+	}
+	return may_load ? unloaded : busy.size();
+}
+
+/**
+ * Loads a replica just taken and replays what it has missed, without holding mtx.
+ */
+void backend_replicas::prepare(std::size_t index, bool load, bool catch_up)
+{
+	if (load)
+	{
+		replicas[index] = make_replica();
+	}
+	if (!catch_up)
+	{
+		return;
+	}
+
+	std::vector<std::function<void(spelling_backend &)>> missed;
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		loaded[index] = true;
+		missed.assign(history.begin() + (replayed[index] - history_start), history.end());
+		replayed[index] = history_start + history.size();
+		compact_history();
+	}
+	for (const std::function<void(spelling_backend &)> &f : missed)
+	{
+		f(*replicas[index]);
+	}
+}
+
+/**
+ * Drops the calls every replica has replayed. Called with mtx held.
+ */
+void backend_replicas::compact_history()
+{
+	std::size_t seen_by_all = *std::min_element(replayed.begin(), replayed.end());
+	history.erase(history.begin(), history.begin() + (seen_by_all - history_start));
+	history_start = seen_by_all;
+}
+
+backend_replicas::lease backend_replicas::acquire()
+{
+	std::unique_lock<std::mutex> lock(mtx);
+	while (true)
+	{
+		std::size_t i = free_replica(true);
+		if (i < busy.size())
+		{
+			busy[i] = true;
+			bool load = !loaded[i];
+			bool catch_up = replayed[i] < history_start + history.size();
+			lock.unlock();
+			lease held(this, i);
+			prepare(i, load, load || catch_up);
+			return held;
+		}
+		cv.wait(lock);
+	}
+}
+
+backend_replicas::lease backend_replicas::acquire_until(std::chrono::steady_clock::time_point deadline)
+{
+	std::unique_lock<std::mutex> lock(mtx);
+	do
+	{
+		std::size_t i = free_replica(false);
+		if (i < busy.size())
+		{
+			busy[i] = true;
+			bool catch_up = replayed[i] < history_start + history.size();
+			lock.unlock();
+			lease held(this, i);
+			prepare(i, false, catch_up);
+			return held;
+		}
+	} while (cv.wait_until(lock, deadline) != std::cv_status::timeout);
+	return lease(nullptr, 0);
+}
+
+void backend_replicas::for_each(const std::function<void(spelling_backend &)> &f)
+{
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		history.push_back(f);
+	}
+
+	for (std::size_t i = 0; i < replicas.size(); ++i)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			if (!loaded[i])
+			{
+				continue;
+			}
+			cv.wait(lock, [&] { return !busy[i]; });
+			busy[i] = true;
+		}
+		lease held(this, i);
+		prepare(i, false, true);
+	}
+}
+
+void backend_replicas::release(std::size_t index)
+{
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		busy[index] = false;
+	}
+	// for_each() waits for one replica in particular, so a single wakeup could go to the wrong waiter
+	cv.notify_all();
+}
+
+backend_replicas::lease::lease(backend_replicas *owner, std::size_t index) : owner(owner), index(index) {}
+
+backend_replicas::lease::lease(lease &&other) : owner(other.owner), index(other.index)
+{
+	other.owner = nullptr;
+}
+
+backend_replicas::lease::~lease()
+{
+	if (owner)
+	{
+		owner->release(index);
+	}
+}
+
+spelling_backend *backend_replicas::lease::operator->() const
+{
+	return owner->replicas[index].get();
+}
+
+spelling_backend &backend_replicas::lease::operator*() const
+{
+	return *owner->replicas[index];
+}
+
+backend_replicas::lease::operator bool() const
+{
+	return owner != nullptr;
+}
@@ -1,24 +1,1062 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
+class Hunspell;
+
+/**
+ * One possible substitution: key is replaced by value. Both are NUL-padded UTF-8
+ * so that the tables can be built at compile time.
+ */
+struct substitution_entry
+{
+	char key[4];
+	char value[8];
+
+	constexpr std::string_view key_view() const
+	{
+		return std::string_view(key);
+	}
+
+	constexpr std::string_view value_view() const
+	{
+		return std::string_view(value);
+	}
+};
+
+/**
+ * Rules that the candidates of a substitution_table must follow on top of its
+ * substitutions. The strings they name are looked for in the values put into a
+ * candidate, so they also catch a letter inside a longer replacement. Limits and
+ * placements apply to each part of a hyphenated compound as to a word.
+ */
+struct substitution_constraints
+{
+	enum position : unsigned
+	{
+		word_initial = 1,
+		word_medial = 2,
+		word_final = 4,
+		anywhere = word_initial | word_medial | word_final
+	};
+
+	/**
+	 * At most max_count of the strings may be put into one candidate.
+	 */
+	struct limit
+	{
+		std::vector<std::string> strings;
+		std::size_t max_count;
+	};
+
+	/**
+	 * The strings may only be put at the given positions of a word.
+	 */
+	struct placement
+	{
+		std::vector<std::string> strings;
+		unsigned positions;
+	};
+
+	std::size_t max_substitutions = SIZE_MAX; // per candidate
+	std::vector<limit> limits;
+	std::vector<placement> placements;
+	std::vector<std::string> forbidden; // sequences no candidate may contain, unless the word itself does
+};
+
+/**
+ * The substitutions of a language, compiled into a trie over the bytes of the keys so
+ * that keys of any length are matched in a single pass over the word.
+ */
 class substitution_table
 {
 private:
-	std::unordered_map<std::string, std::vector<std::string>> table_letters; // letter by letter substitution
-	std::unordered_map<std::string, std::vector<std::string>> table_ligatures; // 2-letter substitution
-	static void generate_substitutions(const std::unordered_map<std::string, std::vector<std::string>> &map, const std::string &input, std::vector<std::string> &result, std::string::size_type index, std::string current, std::string::size_type len_of_key);
+	struct node
+	{
+		std::array<std::uint32_t, 128> next; // by ASCII byte; 0 if no key goes on that way
+		std::uint32_t values_begin; // the values of the key ending here
+		std::uint32_t values_end;
+	};
+	std::vector<node> nodes; // the root first
+	std::vector<std::string> values;
+	bool may_repeat; // whether two ways through the trie can give the same candidate
+
+	substitution_constraints constraints;
+	bool constrained;
+	std::vector<unsigned> value_positions; // where each value may be put
+	std::vector<std::size_t> value_counts; // by value, then by limit: how many of its strings the value holds
+	std::vector<std::string> forbidden; // the forbidden sequences, by last byte
+	std::array<std::uint32_t, 257> forbidden_ends; // where those ending in each byte start in forbidden
+	std::string::size_type length_limit;
+
+	/**
+	 * What the candidate built so far has used up of the constraints.
+	 */
+	struct generation_state
+	{
+		std::size_t substitutions = 0;
+		std::vector<std::size_t> counts; // by limit
+		std::vector<char> forbidden; // by forbidden sequence, whether it is not in the word itself
+	};
+
+	void compile_constraints();
+	bool take(generation_state &state, std::uint32_t value, unsigned position) const;
+	void give_back(generation_state &state, std::uint32_t value) const;
+	bool has_forbidden(const std::string &current, std::string::size_type from, const generation_state &state) const;
+	void generate_substitutions(const std::string &input, std::string::size_type index, std::string &current, const std::function<void(const std::string &)> &yield, const std::function<bool(const std::string &)> &viable, generation_state *state) const;
 
 public:
-	substitution_table(const std::unordered_map<std::string, std::vector<std::string>> &&table_letters, const std::unordered_map<std::string, std::vector<std::string>> &&table_ligatures);
+	/**
+	 * Compiles the substitutions, given as (key, value) pairs in order of preference.
+	 * Values of keys longer than one character are also tried with the single-character
+	 * substitutions applied to them, as if they had been part of the word.
+	 */
+	explicit substitution_table(const std::vector<std::pair<std::string, std::string>> &entries, substitution_constraints constraints = {});
+	/**
+	 * Returns the built-in table of a language (two-letter code), or nullptr.
+	 */
+	static const substitution_table *find(std::string_view lang_code);
+	/**
+	 * Loads a table from a text file. Each line holds a key of printable ASCII
+	 * characters followed by its replacements, separated by whitespace; '#'
+	 * starts a comment. Lines starting with '@' give the constraints: "@max n",
+	 * "@limit n strings...", "@place positions strings..." (positions being initial,
+	 * medial and final, joined by commas) and "@forbid sequences...". Tables with the same content are loaded once and kept for the
+	 * lifetime of the process. Returns nullptr and sets error on failure.
+	 */
+	static const substitution_table *load(const std::filesystem::path &path, std::string &error);
 	static bool is_substitutable(const std::string &s);
 	static const std::string::size_type SUBSTITUTION_MAX_LENGTH;
+	static const std::string::size_type PRUNED_SUBSTITUTION_MAX_LENGTH;
+	/**
+	 * The longest words worth substituting without pruning: SUBSTITUTION_MAX_LENGTH,
+	 * or more if max_substitutions keeps the number of candidates down.
+	 */
+	std::string::size_type max_length() const;
 	std::vector<std::string> substitute(const std::string &original) const;
+	/**
+	 * Calls yield with each candidate in turn, once however many ways lead to it. The
+	 * string passed to yield is a buffer reused between calls. If viable is given, it
+	 * is called with the candidate built so far and the branch is abandoned as soon as
+	 * it returns false.
+	 */
+	void for_each_substitution(const std::string &original, const std::function<void(const std::string &)> &yield, const std::function<bool(const std::string &)> &viable = nullptr) const;
 };
 
-extern const std::unordered_map<std::string, substitution_table> SUBSTITUTION_TABLES;
+/**
+ * What a single pass over a string finds out about it.
+ */
+struct text_class
+{
+	bool ascii; // no byte above 0x7F
+	bool printable_ascii; // only bytes 0x21 to 0x7E: no controls, no spaces
+	bool whitespace; // ASCII whitespace
+	bool banned; // a space, hyphen, apostrophe or U+2019
+};
+
+/**
+ * Classifies s with SSE2 or AVX2 where available, and byte by byte otherwise.
+ */
+text_class classify(std::string_view s);
 
 std::string simplify(const std::string &s);
+/**
+ * Writes the simplified form of s into out, reusing its storage.
+ */
+void simplify(std::string_view s, std::string &out);
 bool is_without_banned_chars(const std::string &s);
+void fold_case(std::string_view s, std::string &out);
+
+/**
+ * Calls yield with the byte offset, code point offset and text of every word of UTF-8
+ * text, as found by ICU's word break rules (runs of letters, kana or ideographs; numbers
+ * and punctuation are skipped). Returns false if ICU fails or the text exceeds 2 GiB.
+ */
+bool for_each_word(std::string_view text, const std::function<void(std::size_t, std::size_t, std::string_view)> &yield);
+
+using affix_flag = std::uint64_t;
+
+/**
+ * A reader for Hunspell .aff/.dic pairs that enumerates the word forms obtained by
+ * applying the affix rules to the stems (up to two suffixes and a cross-product prefix,
+ * which may bring suffixes of its own through its continuation class).
+ * Compounds are not generated.
+ */
+class affix_dictionary
+{
+private:
+	enum class flag_mode
+	{
+		single,
+		long_pairs,
+		numeric
+	};
+
+	struct condition_unit
+	{
+		bool any;
+		bool negated;
+		std::vector<char32_t> chars;
+	};
+
+	struct affix_entry
+	{
+		std::string strip;
+		std::string append;
+		std::vector<affix_flag> continuation;
+		std::vector<condition_unit> condition;
+	};
+
+	struct affix_class
+	{
+		bool cross_product;
+		std::vector<affix_entry> entries;
+	};
+
+	std::filesystem::path dic_path;
+	std::string encoding;
+	flag_mode mode;
+	std::vector<std::vector<affix_flag>> flag_aliases;
+	std::unordered_map<affix_flag, affix_class> prefixes;
+	std::unordered_map<affix_flag, affix_class> suffixes;
+	affix_flag need_affix;
+	affix_flag only_in_compound;
+	affix_flag forbidden_word;
+	affix_flag circumfix;
+
+	std::string to_utf8(const std::string &line) const;
+	std::vector<affix_flag> parse_flags(std::string_view s) const;
+	/**
+	 * The flags of a .dic entry or an affix continuation class, the only places where
+	 * an AF alias may stand for them.
+	 */
+	std::vector<affix_flag> parse_flag_field(std::string_view s) const;
+	static std::vector<condition_unit> parse_condition(const std::string &s);
+	static bool matches(const std::vector<condition_unit> &condition, const std::u32string &word, bool at_end);
+	static bool apply(const affix_entry &entry, const std::string &word, bool is_suffix, std::string &result);
+	static bool has_flag(const std::vector<affix_flag> &flags, affix_flag flag);
+
+public:
+	bool loaded;
+	bool compounding; // the dictionary accepts compounds that are not enumerated
+	bool transforms_input; // IGNORE, ICONV or COMPLEXPREFIXES make enumerated forms unreliable
+
+	affix_dictionary(const std::filesystem::path &aff_path, const std::filesystem::path &dic_path);
+	/**
+	 * Calls emit with every word form. standalone is false for forms Hunspell only accepts
+	 * in compounds or with a further affix. Returns false if the dictionary could not be
+	 * read or has more than max_forms forms.
+	 */
+	bool expand(const std::function<void(const std::string &form, bool standalone)> &emit, std::size_t max_forms) const;
+};
+
+class mapped_file;
+class task_group;
+
+/**
+ * Answers, ignoring case, whether some word accepted by a dictionary starts with a given
+ * prefix. Used to prune the substitution search early.
+ * The filter is a single image made of a header, the offsets of the forms and the
+ * case-folded forms themselves, sorted, so that it can be stored as is.
+ */
+class prefix_filter
+{
+private:
+	struct header
+	{
+		std::uint64_t n_forms;
+		std::uint64_t arena_size;
+		std::uint64_t compounding;
+	};
+
+	std::vector<std::uint64_t> storage;
+	std::unique_ptr<mapped_file> mapping;
+	std::size_t image_size;
+	const header *hdr;
+	const std::uint32_t *offsets; // one more than the number of forms
+	const char *arena;
+	std::vector<std::string> additions; // case-folded words added at runtime
+	mutable std::shared_mutex additions_mtx;
+
+	prefix_filter();
+	void attach(const void *image);
+	std::string_view form(std::size_t i) const;
+	std::size_t lower_bound(std::string_view key) const;
+	bool has_prefix(std::string_view folded) const;
+	bool contains(std::string_view folded) const;
+	bool viable_folded(std::string_view folded, int depth) const;
+
+public:
+	static const std::size_t MAX_FORMS;
+	static const std::uint32_t FILE_VERSION;
+	~prefix_filter();
+	static prefix_filter *build(const affix_dictionary &dictionary);
+	/**
+	 * Maps a file written by save(), or returns nullptr as orthographic_index::open() does.
+	 */
+	static prefix_filter *open(const std::filesystem::path &path, const std::filesystem::path &aff_path, const std::filesystem::path &dic_path);
+	bool save(const std::filesystem::path &path, const std::filesystem::path &aff_path, const std::filesystem::path &dic_path) const;
+	bool viable(const std::string &prefix) const;
+	void add(const std::string &word);
+};
+
+/**
+ * A process-wide pool of worker threads shared by all spellers.
+ * Each worker owns a queue; it takes its own tasks from the back and steals
+ * from the front of the others' when it runs dry. Threads waiting on a
+ * task_group help with the group's queued tasks instead of sleeping, so a pool
+ * of size 0 simply runs a group on the calling thread.
+ */
+class thread_pool
+{
+private:
+	struct queued_task
+	{
+		const task_group *group; // nullptr for a task submitted on its own
+		std::function<void()> run;
+	};
+
+	struct worker_queue
+	{
+		std::mutex mtx;
+		std::deque<queued_task> tasks;
+	};
+
+	std::vector<std::unique_ptr<worker_queue>> queues;
+	std::vector<std::thread> workers;
+	std::shared_mutex queues_mtx; // exclusive only while resizing
+	std::mutex idle_mtx;
+	std::condition_variable idle_cv;
+	std::atomic<std::size_t> pending;
+	std::atomic<std::size_t> next_queue;
+	std::size_t n_workers; // guarded by queues_mtx
+	bool stopping;
+	std::mutex resize_mtx;
+	std::atomic<std::uint64_t> n_threads_started;
+	std::atomic<std::uint64_t> n_tasks;
+	std::atomic<std::uint64_t> n_steals;
+
+	thread_pool(std::size_t size);
+	void start(std::size_t size);
+	void stop();
+	void work(std::size_t index);
+	static bool take(std::deque<queued_task> &tasks, bool from_back, const task_group *group, std::function<void()> &task);
+	bool try_pop(std::size_t preferred, const task_group *group, std::function<void()> &task);
+
+public:
+	~thread_pool();
+	static thread_pool &instance();
+	static std::size_t default_size();
+	std::size_t size();
+	/**
+	 * Resizing to 0 runs the tasks still queued on the calling thread.
+	 */
+	void resize(std::size_t size);
+	/**
+	 * A task submitted without a group to a pool without workers runs on the calling thread.
+	 */
+	void submit(std::function<void()> &&task, const task_group *group = nullptr);
+	/**
+	 * Runs one of the tasks group has queued on the calling thread, if there is one.
+	 * Tasks of other groups are left alone, however long the wait.
+	 */
+	bool run_pending_task(const task_group &group);
+	/**
+	 * Makes a new pool with as many workers as the parent's in a child process, where only
+	 * the forking thread survives fork(). The child must not fork while calls are running.
+	 * Tasks still queued without a group are carried over, if the old pool's locks are free.
+	 */
+	static void replace_after_fork();
+	/**
+	 * Counted since the pool was created, whether statistics are enabled or not.
+	 */
+	std::uint64_t threads_started() const;
+	std::uint64_t tasks_submitted() const;
+	/**
+	 * Tasks not run by the worker whose queue they were put on.
+	 */
+	std::uint64_t tasks_stolen() const;
+};
+
+/**
+ * A spellchecking engine. Spellers only use engines through this interface, each instance
+ * from one thread at a time.
+ */
+class spelling_backend
+{
+public:
+	virtual ~spelling_backend();
+	virtual bool spell(const std::string &word) = 0;
+	virtual std::vector<std::string> suggest(const std::string &word) = 0;
+	virtual std::vector<std::string> analyse(const std::string &word) = 0;
+	virtual std::vector<std::string> stem(const std::string &word) = 0;
+	/**
+	 * Makes spell() accept word from then on.
+	 */
+	virtual void add(const std::string &word) = 0;
+};
+
+/**
+ * Loads a new instance of an engine.
+ */
+using backend_loader = std::function<std::unique_ptr<spelling_backend>()>;
+
+class hunspell_backend : public spelling_backend
+{
+private:
+	std::unique_ptr<Hunspell> hunspell;
+
+public:
+	hunspell_backend(const std::filesystem::path &aff_path, const std::filesystem::path &dic_path);
+	~hunspell_backend() override;
+	static backend_loader loader(const std::filesystem::path &aff_path, const std::filesystem::path &dic_path);
+	bool spell(const std::string &word) override;
+	std::vector<std::string> suggest(const std::string &word) override;
+	std::vector<std::string> analyse(const std::string &word) override;
+	std::vector<std::string> stem(const std::string &word) override;
+	void add(const std::string &word) override;
+};
+
+/**
+ * Engines such as Hunspell are not documented as safe for concurrent use, so a speller
+ * keeps one or more identical replicas and lends each of them to one thread at a time.
+ * Lazy replicas are only loaded when first lent, which for_each() allows for by keeping
+ * what it did to replay it on them.
+ */
+class backend_replicas
+{
+private:
+	backend_loader make_replica;
+	std::vector<std::unique_ptr<spelling_backend>> replicas;
+	std::vector<bool> busy;
+	std::vector<bool> loaded;
+	std::vector<std::size_t> replayed; // how much of history each replica has seen, counting from the very first call
+	std::vector<std::function<void(spelling_backend &)>> history; // the calls not yet seen by every replica
+	std::size_t history_start; // how many calls every replica has seen and were dropped from history
+	std::mutex mtx;
+	std::condition_variable cv;
+
+	std::size_t free_replica(bool may_load) const;
+	void prepare(std::size_t index, bool load, bool catch_up);
+	void compact_history();
+	void release(std::size_t index);
+
+public:
+	class lease
+	{
+	private:
+		backend_replicas *owner;
+		std::size_t index;
+
+	public:
+		lease(backend_replicas *owner, std::size_t index);
+		lease(lease &&other);
+		lease(const lease &) = delete;
+		~lease();
+		spelling_backend *operator->() const;
+		spelling_backend &operator*() const;
+		/**
+		 * False for the empty lease returned by acquire_until() when it gives up.
+		 */
+		explicit operator bool() const;
+	};
+
+	backend_replicas(backend_loader load, std::size_t n, bool lazy);
+	~backend_replicas();
+	std::size_t size() const;
+	lease acquire();
+	/**
+	 * Like acquire(), but gives up at the deadline and returns an empty lease.
+	 * Replicas not loaded yet are left alone, loading being anything but quick.
+	 */
+	lease acquire_until(std::chrono::steady_clock::time_point deadline);
+	/**
+	 * Runs f on every replica in turn, each while no other thread holds it, and on
+	 * replicas not loaded yet when they are.
+	 */
+	void for_each(const std::function<void(spelling_backend &)> &f);
+};
+
+/**
+ * A set of tasks submitted to the pool that can be waited on together.
+ */
+class task_group
+{
+private:
+	std::atomic<std::size_t> outstanding;
+	std::mutex mtx;
+	std::condition_variable cv;
+
+public:
+	task_group();
+	~task_group();
+	void run(std::function<void()> &&task);
+	void wait();
+};
+
+std::uint64_t checksum(const void *data, std::size_t size);
+
+/**
+ * A read-only shared mapping of a whole file.
+ */
+class mapped_file
+{
+private:
+	void *address;
+	std::size_t length;
+
+	mapped_file(void *address, std::size_t length);
+
+public:
+	~mapped_file();
+	enum class advice
+	{
+		sequential,
+		will_need,
+		dont_need // the pages are read again from the file if touched later
+	};
+
+	static mapped_file *open(const std::filesystem::path &path);
+	const char *data() const;
+	std::size_t size() const;
+	/**
+	 * Passes an madvise() hint for the pages covering [offset, offset + size).
+	 */
+	void advise(std::size_t offset, std::size_t size, advice a) const;
+};
+
+/**
+ * Writes the parts to a temporary file next to path and renames it into place,
+ * so that readers never see a partial file.
+ */
+bool write_file_atomically(const std::filesystem::path &path, const std::vector<std::string_view> &parts);
+
+/**
+ * Identifies the state of an .aff/.dic pair that derived data was built from.
+ */
+struct dictionary_fingerprint
+{
+	std::uint64_t aff_size;
+	std::uint64_t aff_mtime;
+	std::uint64_t aff_hash;
+	std::uint64_t dic_size;
+	std::uint64_t dic_mtime;
+	std::uint64_t dic_hash;
+
+	static dictionary_fingerprint of(const std::filesystem::path &aff_path, const std::filesystem::path &dic_path);
+	/**
+	 * Whether the files are unchanged: either their sizes and modification times are
+	 * the same, or their sizes and contents are.
+	 */
+	bool is_current(const std::filesystem::path &aff_path, const std::filesystem::path &dic_path) const;
+};
+
+/**
+ * Stores the image of data derived from a dictionary in a file, with a header identifying
+ * the kind of data, its version and the state of the dictionary, and a checksum of the
+ * image that is checked against the file once it is written.
+ */
+bool save_image(const std::filesystem::path &path, const char (&magic)[8], std::uint32_t version, const std::filesystem::path &aff_path, const std::filesystem::path &dic_path, const void *image, std::size_t size);
+/**
+ * Maps a file written by save_image(). Returns nullptr if it is missing, truncated, of
+ * another kind or version, or out of date with respect to the dictionary. Only the header
+ * is read, so that the pages of the image are loaded as they are used; building with
+ * SIBEL_VERIFY_IMAGES defined also checks the whole image against its checksum.
+ * The image starts image_offset() bytes into the file.
+ */
+mapped_file *open_image(const std::filesystem::path &path, const char (&magic)[8], std::uint32_t version, const std::filesystem::path &aff_path, const std::filesystem::path &dic_path);
+std::size_t image_offset();
+
+/**
+ * Maps the simplify() key of every dictionary word form to the forms themselves.
+ * The index is a single image made of a header, open-addressing hash buckets,
+ * entries, form references and a string arena, so that it can be stored as is.
+ */
+class orthographic_index
+{
+private:
+	struct header
+	{
+		std::uint64_t n_buckets;
+		std::uint64_t n_entries;
+		std::uint64_t n_forms;
+		std::uint64_t arena_size;
+		std::uint64_t exhaustive;
+	};
+
+	struct entry
+	{
+		std::uint32_t key_offset;
+		std::uint32_t key_length;
+		std::uint32_t first_form;
+		std::uint32_t n_forms;
+	};
+
+	struct form_ref
+	{
+		std::uint32_t offset;
+		std::uint32_t length;
+	};
+
+	std::vector<std::uint64_t> storage;
+	std::unique_ptr<mapped_file> mapping;
+	std::unordered_multimap<std::string, std::string> additions; // words added at runtime, by key
+	mutable std::shared_mutex additions_mtx;
+	std::size_t image_size;
+	const header *hdr;
+	const std::uint32_t *buckets;
+	const entry *entries;
+	const form_ref *forms;
+	const char *arena;
+
+	orthographic_index();
+	void attach(const void *image);
+	void lookup(std::string_view key, const std::function<void(std::string_view)> &emit) const;
+
+public:
+	static const std::size_t MAX_FORMS;
+	static const std::uint32_t FILE_VERSION;
+	static std::uint64_t hash(std::string_view s);
+	static orthographic_index *build(const affix_dictionary &dictionary);
+	/**
+	 * Maps a file written by save(). Returns nullptr if it is missing, damaged,
+	 * of another version or out of date with respect to the dictionary.
+	 */
+	static orthographic_index *open(const std::filesystem::path &path, const std::filesystem::path &aff_path, const std::filesystem::path &dic_path);
+	bool save(const std::filesystem::path &path, const std::filesystem::path &aff_path, const std::filesystem::path &dic_path) const;
+	/**
+	 * The dictionary forms whose key is that of word, also trying the lower-case
+	 * variants of a capitalised or upper-case word and recasing what they find.
+	 * Some of them may still be rejected by Hunspell, e.g. forms only valid in compounds.
+	 */
+	std::vector<std::string> candidates(const std::string &word) const;
+	/**
+	 * Whether the dictionary accepts no word form beyond those enumerated, i.e. it has
+	 * no compounds and does not transform its input, so that a hit is the whole answer.
+	 */
+	bool exhaustive() const;
+	void add(const std::string &word);
+};
+
+/**
+ * The word forms of a dictionary as they are written, so that spell() can accept most
+ * words with one hash lookup and no affix stripping. Only forms the backend accepted when
+ * the set was built are kept: a word in the set is correct, while any other word may still
+ * be (as a compound, in capitals and so on) and must be asked of the backend.
+ * Like the index, the set is a single image made of a header, open-addressing hash buckets,
+ * form references and a string arena, so that it can be stored as is.
+ */
+class word_set
+{
+private:
+	struct header
+	{
+		std::uint64_t n_buckets;
+		std::uint64_t n_forms;
+		std::uint64_t arena_size;
+	};
+
+	struct form_ref
+	{
+		std::uint32_t offset;
+		std::uint32_t length;
+	};
+
+	std::vector<std::uint64_t> storage;
+	std::unique_ptr<mapped_file> mapping;
+	std::size_t image_size;
+	const header *hdr;
+	const std::uint32_t *buckets;
+	const form_ref *forms;
+	const char *arena;
+
+	word_set();
+	void attach(const void *image);
+
+public:
+	static const std::size_t MAX_FORMS;
+	static const std::uint32_t FILE_VERSION;
+	/**
+	 * Returns nullptr if the dictionary cannot be fully enumerated, or if its input is
+	 * transformed (IGNORE, ICONV...) so that the forms are not what spell() is given.
+	 */
+	static word_set *build(const affix_dictionary &dictionary, spelling_backend &backend);
+	/**
+	 * Maps a file written by save(), or returns nullptr as orthographic_index::open() does.
+	 */
+	static word_set *open(const std::filesystem::path &path, const std::filesystem::path &aff_path, const std::filesystem::path &dic_path);
+	bool save(const std::filesystem::path &path, const std::filesystem::path &aff_path, const std::filesystem::path &dic_path) const;
+	bool contains(std::string_view word) const;
+	std::size_t size() const;
+};
+
+/**
+ * How often words are used, read from a list with a word and its count on each line, to
+ * rank results by. Lines without a count rank below all those with one, in their order.
+ * Like the index, the list is compiled into a single image made of a header, open-addressing
+ * hash buckets, entries and a string arena, so that it can be stored as is.
+ */
+class word_frequencies
+{
+private:
+	struct header
+	{
+		std::uint64_t n_buckets;
+		std::uint64_t n_words;
+		std::uint64_t arena_size;
+	};
+
+	struct entry
+	{
+		std::uint32_t offset;
+		std::uint32_t length;
+		double score;
+	};
+
+	std::vector<std::uint64_t> storage;
+	std::unique_ptr<mapped_file> mapping;
+	std::size_t image_size;
+	const header *hdr;
+	const std::uint32_t *buckets;
+	const entry *entries;
+	const char *arena;
+
+	word_frequencies();
+	void attach(const void *image);
+	const entry *find(std::string_view word) const;
+
+public:
+	static const std::uint32_t FILE_VERSION;
+	/**
+	 * Reads the list at path, or returns nullptr with a message in error.
+	 */
+	static word_frequencies *build(const std::filesystem::path &path, std::string &error);
+	/**
+	 * Maps a file written by save(), or returns nullptr if it is missing, damaged, of another
+	 * version or out of date with respect to the list.
+	 */
+	static word_frequencies *open(const std::filesystem::path &path, const std::filesystem::path &list_path);
+	bool save(const std::filesystem::path &path, const std::filesystem::path &list_path) const;
+	/**
+	 * Higher for more frequent words. A word not in the list is looked up in lower case,
+	 * and if it is not there either, it ranks below all others.
+	 */
+	double score(std::string_view word) const;
+	/**
+	 * Sorts words from the most to the least frequent, keeping the order of equals.
+	 */
+	void rank(std::vector<std::string> &words) const;
+};
+
+/**
+ * A symmetric delete index (as in SymSpell) over the standalone word forms of a dictionary,
+ * which finds the forms within MAX_DISTANCE edits of a word without trying edits of it
+ * against the dictionary. Every form is filed under the strings left by deleting up to
+ * MAX_DISTANCE code points from its first PREFIX_LENGTH code points; a word is looked up
+ * under its own such strings, and the forms found are then measured against it.
+ * Only hashes of the deletions are kept, in a table sorted by hash with a directory on
+ * their top bits, so that the index is a single image that can be stored as is.
+ */
+class deletion_index
+{
+private:
+	struct header
+	{
+		std::uint64_t n_forms;
+		std::uint64_t arena_size;
+		std::uint64_t n_entries;
+		std::uint64_t directory_bits;
+	};
+
+	struct entry
+	{
+		std::uint32_t check; // the low bits of the hash
+		std::uint32_t form;
+	};
+
+	struct form_ref
+	{
+		std::uint32_t offset;
+		std::uint32_t length;
+	};
+
+	std::vector<std::uint64_t> storage;
+	std::unique_ptr<mapped_file> mapping;
+	std::size_t image_size;
+	const header *hdr;
+	const std::uint32_t *directory; // one more than 2 ** directory_bits
+	const entry *entries;
+	const form_ref *forms;
+	const char *arena;
+	std::vector<std::string> additions; // words added at runtime
+	std::unordered_multimap<std::uint64_t, std::uint32_t> added_deletions; // the hashes of their deletions, to the word
+	mutable std::shared_mutex additions_mtx;
+
+	deletion_index();
+	void attach(const void *image);
+	static void deletions(const std::u32string &word, std::vector<std::uint64_t> &hashes);
+
+public:
+	static const std::size_t MAX_FORMS;
+	static const std::uint32_t FILE_VERSION;
+	static const std::size_t MAX_DISTANCE;
+	static const std::size_t PREFIX_LENGTH;
+	static deletion_index *build(const affix_dictionary &dictionary);
+	/**
+	 * Maps a file written by save(), or returns nullptr as orthographic_index::open() does.
+	 */
+	static deletion_index *open(const std::filesystem::path &path, const std::filesystem::path &aff_path, const std::filesystem::path &dic_path);
+	bool save(const std::filesystem::path &path, const std::filesystem::path &aff_path, const std::filesystem::path &dic_path) const;
+	/**
+	 * The forms within MAX_DISTANCE edits (insertions, deletions, substitutions and
+	 * transpositions of adjacent code points) of word, other than word itself, nearest
+	 * first, then the most frequent first if frequencies are given, then alphabetically
+	 * ignoring case, so that capitalised forms do not all come before the others.
+	 */
+	std::vector<std::string> nearby(const std::string &word, const word_frequencies *frequencies = nullptr) const;
+	void add(const std::string &word);
+};
+
+/**
+ * A bounded cache keyed by word, with CLOCK (second chance) eviction. It is split into
+ * shards with a lock each so that threads rarely contend. A capacity of 0 disables it.
+ * get() reports the generation it saw, and put() drops results computed before a clear().
+ */
+template <typename V>
+class clock_cache
+{
+private:
+	struct slot
+	{
+		std::string key;
+		V value;
+		bool referenced;
+	};
+
+	struct shard
+	{
+		std::mutex mtx;
+		std::vector<slot> slots;
+		std::unordered_map<std::string, std::size_t> positions;
+		std::size_t hand = 0;
+		std::size_t capacity = 0;
+	};
+
+	static const std::size_t MAX_SHARDS = 16;
+
+	std::vector<std::unique_ptr<shard>> shards;
+	std::size_t total_capacity;
+	std::atomic<std::uint64_t> current_generation;
+	std::atomic<std::uint64_t> n_hits;
+	std::atomic<std::uint64_t> n_misses;
+
+	shard &shard_for(const std::string &key)
+	{
+		return *shards[std::hash<std::string>{}(key) % shards.size()];
+	}
+
+public:
+	explicit clock_cache(std::size_t capacity = 0) : total_capacity(capacity), current_generation(0), n_hits(0), n_misses(0)
+	{
+		std::size_t n_shards = std::min(capacity, MAX_SHARDS);
+		for (std::size_t i = 0; i < n_shards; ++i)
+		{
+			shards.push_back(std::make_unique<shard>());
+			shards.back()->capacity = capacity / n_shards + (i < capacity % n_shards ? 1 : 0);
+		}
+	}
+
+	bool get(const std::string &key, V &value, std::uint64_t &generation)
+	{
+		if (shards.empty())
+		{
+			return false;
+		}
+
+		generation = current_generation.load();
+		shard &s = shard_for(key);
+		std::lock_guard<std::mutex> lock(s.mtx);
+		auto it = s.positions.find(key);
+		if (it == s.positions.end())
+		{
+			++n_misses;
+			return false;
+		}
+		slot &found = s.slots[it->second];
+		found.referenced = true;
+		value = found.value;
+		++n_hits;
+		return true;
+	}
+
+	void put(const std::string &key, const V &value, std::uint64_t generation)
+	{
+		if (shards.empty())
+		{
+			return;
+		}
+
+		shard &s = shard_for(key);
+		std::lock_guard<std::mutex> lock(s.mtx);
+		if (generation != current_generation.load() || s.positions.count(key))
+		{
+			return;
+		}
+
+		if (s.slots.size() < s.capacity)
+		{
+			s.positions.emplace(key, s.slots.size());
+			s.slots.push_back({key, value, false});
+			return;
+		}
+
+		// Give every referenced slot a second chance before evicting it
+		while (s.slots[s.hand].referenced)
+		{
+			s.slots[s.hand].referenced = false;
+			s.hand = (s.hand + 1) % s.slots.size();
+		}
+		slot &victim = s.slots[s.hand];
+		s.positions.erase(victim.key);
+		victim = {key, value, false};
+		s.positions.emplace(key, s.hand);
+		s.hand = (s.hand + 1) % s.slots.size();
+	}
+
+	void clear()
+	{
+		// Bumped first, so that a put() racing with the clearing is either dropped or cleared
+		++current_generation;
+		for (std::unique_ptr<shard> &s : shards)
+		{
+			std::lock_guard<std::mutex> lock(s->mtx);
+			s->slots.clear();
+			s->positions.clear();
+			s->hand = 0;
+		}
+	}
+
+	std::size_t size()
+	{
+		std::size_t n = 0;
+		for (std::unique_ptr<shard> &s : shards)
+		{
+			std::lock_guard<std::mutex> lock(s->mtx);
+			n += s->slots.size();
+		}
+		return n;
+	}
+
+	std::size_t capacity() const
+	{
+		return total_capacity;
+	}
+
+	std::uint64_t hits() const
+	{
+		return n_hits.load();
+	}
+
+	std::uint64_t misses() const
+	{
+		return n_misses.load();
+	}
+};
+
+/**
+ * Whether calls are timed and counted. Off by default; while it is off, recording
+ * costs one relaxed load.
+ */
+inline std::atomic<bool> stats_enabled(false);
+
+/**
+ * The number of calls to a method and a histogram of their latencies, bucket i
+ * counting calls that took [2^i, 2^(i+1)) nanoseconds. All counters are lock-free.
+ */
+class method_stats
+{
+public:
+	static const std::size_t LATENCY_BUCKETS = 40; // the last one takes everything above 9 minutes
+
+private:
+	std::atomic<std::uint64_t> n_calls{0};
+	std::atomic<std::uint64_t> total_ns{0};
+	std::atomic<std::uint64_t> buckets[LATENCY_BUCKETS]{};
+
+public:
+	void record(std::uint64_t ns)
+	{
+		std::size_t bucket = std::min<std::size_t>(63 - __builtin_clzll(ns | 1), LATENCY_BUCKETS - 1);
+		n_calls.fetch_add(1, std::memory_order_relaxed);
+		total_ns.fetch_add(ns, std::memory_order_relaxed);
+		buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	std::uint64_t calls() const
+	{
+		return n_calls.load(std::memory_order_relaxed);
+	}
+
+	std::uint64_t total_time_ns() const
+	{
+		return total_ns.load(std::memory_order_relaxed);
+	}
+
+	std::uint64_t bucket(std::size_t i) const
+	{
+		return buckets[i].load(std::memory_order_relaxed);
+	}
+};
+
+/**
+ * Records the time from its construction to its destruction into one or two method_stats
+ * (a speller's own and the process-wide ones), if collection was enabled when it was created.
+ */
+class stats_timer
+{
+private:
+	method_stats *first;
+	method_stats *second;
+	std::chrono::steady_clock::time_point start;
+
+public:
+	stats_timer(method_stats &first, method_stats &second)
+		: first(nullptr), second(nullptr)
+	{
+		if (stats_enabled.load(std::memory_order_relaxed))
+		{
+			this->first = &first;
+			this->second = &second;
+			start = std::chrono::steady_clock::now();
+		}
+	}
+
+	stats_timer(const stats_timer &) = delete;
+	stats_timer &operator=(const stats_timer &) = delete;
+
+	~stats_timer()
+	{
+		if (first)
+		{
+			std::uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+			first->record(ns);
+			second->record(ns);
+		}
+	}
+};
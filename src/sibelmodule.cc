@@ -1,326 +1,3316 @@
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
+#include <structmember.h>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <deque>
 #include <filesystem>
-#include <hunspell/hunspell.hxx>
-#include <mutex>
-#include <thread>
+#include <optional>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <unordered_set>
 
 #include "sibel.h"
 
 static PyObject * DictionaryLoadingError; // Note that Hunspell itself does not throw exceptions.
 
+static const std::size_t CANDIDATE_BATCH_SIZE = 32;
+
+/**
+ * How many candidates the fallback stage of a call past its deadline may check.
+ */
+static const std::size_t QUICK_CANDIDATE_LIMIT = 1024;
+
+/**
+ * How many suggestions the deletion index gives unless told otherwise, which is the most
+ * Hunspell gives.
+ */
+static const std::size_t INDEXED_SUGGESTION_LIMIT = 15;
+
+/**
+ * The optional per-speller caches of results, one per method.
+ */
+struct result_caches
+{
+	clock_cache<bool> spell;
+	clock_cache<std::vector<std::string>> suggest;
+	clock_cache<std::vector<std::string>> analyse;
+	clock_cache<std::vector<std::string>> stem;
+	clock_cache<std::vector<std::string>> orthographic_forms;
+
+	result_caches(std::size_t spell, std::size_t suggest, std::size_t analyse, std::size_t stem, std::size_t orthographic_forms) : spell(spell), suggest(suggest), analyse(analyse), stem(stem), orthographic_forms(orthographic_forms) {}
+
+	void clear()
+	{
+		spell.clear();
+		suggest.clear();
+		analyse.clear();
+		stem.clear();
+		orthographic_forms.clear();
+	}
+};
+
+enum class timed_method
+{
+	spell,
+	suggest,
+	analyse,
+	stem,
+	orthographic_forms,
+	spell_many,
+	suggest_many,
+	analyse_many,
+	stem_many,
+	add,
+	check_text,
+	check_file, // until the iterator is exhausted or dropped
+	aspell, // the async methods until their result is ready
+	asuggest,
+	aanalyse,
+	astem,
+	aorthographic_forms,
+	acheck_text
+};
+
+static const char * TIMED_METHODS[] = { "spell", "suggest", "analyse", "stem", "orthographic_forms", "spell_many", "suggest_many", "analyse_many", "stem_many", "add", "check_text", "check_file", "aspell", "asuggest", "aanalyse", "astem", "aorthographic_forms", "acheck_text" };
+
+/**
+ * The ways orthographic_forms() can find its answer.
+ */
+enum class orthographic_path
+{
+	not_substitutable, // the word itself is checked
+	index,
+	substitution_table,
+	suggest_fallback, // suggestions with the same simplified form
+	suggestion_index // the same, from the deletion index
+};
+
+static const char * ORTHOGRAPHIC_PATHS[] = { "not_substitutable", "index", "substitution_table", "suggest_fallback", "suggestion_index" };
+
+/**
+ * What suggest() asks: Hunspell, or the deletion index.
+ */
+enum class suggestion_engine
+{
+	hunspell,
+	fast
+};
+
+/**
+ * The statistics of one speller, or of all of them. Only updated while stats_enabled is set.
+ */
+struct speller_stats
+{
+	method_stats methods[std::size(TIMED_METHODS)];
+	method_stats without_gil;
+	std::atomic<std::uint64_t> paths[std::size(ORTHOGRAPHIC_PATHS)]{};
+	std::atomic<std::uint64_t> candidates_generated{0};
+	std::atomic<std::uint64_t> candidates_pruned{0}; // abandoned as prefixes by the prefix filter
+	std::atomic<std::uint64_t> candidates_checked{0}; // by Hunspell
+	std::atomic<std::uint64_t> partial_results{0}; // returned when a deadline passed
+	std::atomic<std::uint64_t> word_set_hits{0}; // words accepted without asking the backend
+};
+
+static speller_stats all_spellers_stats;
+
+/**
+ * Keeps the str objects of short results, which recur often (stems, common suggestions),
+ * so that they are not decoded again. Only used with the GIL held.
+ */
+class string_interner
+{
+private:
+	static const std::size_t MAX_LENGTH = 32;
+	static const std::size_t CAPACITY = 4096;
+	std::unordered_map<std::string, PyObject *> strings;
+
+public:
+	string_interner() = default;
+	string_interner(const string_interner &) = delete;
+	string_interner & operator=(const string_interner &) = delete;
+
+	~string_interner()
+	{
+		clear();
+	}
+
+	void clear()
+	{
+		for (auto & [s, str] : strings)
+		{
+			Py_DECREF(str);
+		}
+		strings.clear();
+	}
+
+	/**
+	 * Returns a new reference to a str equal to s.
+	 */
+	PyObject * get(const std::string & s)
+	{
+		if (s.size() > MAX_LENGTH)
+		{
+			return PyUnicode_FromStringAndSize(s.data(), s.size());
+		}
+
+		auto it = strings.find(s);
+		if (it != strings.end())
+		{
+			Py_INCREF(it->second);
+			return it->second;
+		}
+
+		PyObject * str = PyUnicode_FromStringAndSize(s.data(), s.size());
+		if (str == nullptr)
+		{
+			return nullptr;
+		}
+		// Starting afresh keeps the strings of the current text
+		if (strings.size() == CAPACITY)
+		{
+			clear();
+		}
+		Py_INCREF(str);
+		strings.emplace(s, str);
+		return str;
+	}
+};
+
+typedef struct
+{
+	PyObject_HEAD
+	backend_replicas * backends;
+	word_set * lexicon; // forms known to be correct, asked before the backend
+	const substitution_table * sub_table;
+	prefix_filter * filter;
+	orthographic_index * index;
+	deletion_index * deletions;
+	word_frequencies * frequencies; // ranks suggestions and forms, if given
+	result_caches * caches;
+	speller_stats * stats;
+	string_interner * strings;
+	task_group * background; // calls still running after their caller gave up on them
+} Speller;
+
+/**
+ * A list of results that also tells whether the call stopped early at its deadline.
+ */
+typedef struct
+{
+	PyListObject list;
+	char partial;
+} ResultList;
+
+static PyMemberDef ResultList_members[] = {
+	{ "partial", T_BOOL, offsetof(ResultList, partial), READONLY, "Whether the deadline passed before all results were found" },
+	{ nullptr, 0, 0, 0, nullptr }
+};
+
+static PyTypeObject ResultListType = {
+	PyVarObject_HEAD_INIT(nullptr, 0)
+	.tp_name = "sibel.ResultList",
+	.tp_basicsize = sizeof(ResultList),
+	.tp_itemsize = 0,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_doc = "The results of a call given max_results or timeout_ms",
+	.tp_members = ResultList_members,
+};
+
+/**
+ * The limits given to a call by its max_results, timeout_ms and top_k arguments.
+ */
+struct call_limits
+{
+	std::size_t max_results = SIZE_MAX;
+	std::size_t top_k = SIZE_MAX; // only the best results are wanted, so the rest need not be found
+	std::optional<std::chrono::steady_clock::time_point> deadline;
+
+	bool expired() const
+	{
+		return deadline && std::chrono::steady_clock::now() >= *deadline;
+	}
+};
+
+static stats_timer time_method(Speller * self, timed_method method)
+{
+	std::size_t i = static_cast<std::size_t>(method);
+	return stats_timer(self->stats->methods[i], all_spellers_stats.methods[i]);
+}
+
+/**
+ * Like time_method(), for calls whose work goes on after they return.
+ */
+static std::unique_ptr<stats_timer> time_method_until_done(Speller * self, timed_method method)
+{
+	std::size_t i = static_cast<std::size_t>(method);
+	return std::make_unique<stats_timer>(self->stats->methods[i], all_spellers_stats.methods[i]);
+}
+
+/**
+ * Py_BEGIN_ALLOW_THREADS and Py_END_ALLOW_THREADS, also timing the part without the GIL.
+ */
+#define BEGIN_WITHOUT_GIL(self) Py_BEGIN_ALLOW_THREADS { stats_timer without_gil_timer(self->stats->without_gil, all_spellers_stats.without_gil);
+#define END_WITHOUT_GIL } Py_END_ALLOW_THREADS
+
+static void count(Speller * self, std::atomic<std::uint64_t> speller_stats::* counter, std::uint64_t n)
+{
+	if (stats_enabled.load(std::memory_order_relaxed) && n > 0)
+	{
+		(self->stats->*counter).fetch_add(n, std::memory_order_relaxed);
+		(all_spellers_stats.*counter).fetch_add(n, std::memory_order_relaxed);
+	}
+}
+
+static void count(Speller * self, orthographic_path path)
+{
+	if (stats_enabled.load(std::memory_order_relaxed))
+	{
+		std::size_t i = static_cast<std::size_t>(path);
+		self->stats->paths[i].fetch_add(1, std::memory_order_relaxed);
+		all_spellers_stats.paths[i].fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+static const char * CACHED_METHODS[] = { "spell", "suggest", "analyse", "stem", "orthographic_forms" };
+
+/**
+ * Returns the cached result for word, or computes and caches it.
+ */
+template <typename V, typename F>
+static V cached(clock_cache<V> & cache, const std::string & word, F compute)
+{
+	V value{};
+	std::uint64_t generation = 0;
+	if (cache.get(word, value, generation))
+	{
+		return value;
+	}
+	value = compute();
+	cache.put(word, value, generation);
+	return value;
+}
+
+static PyObject * Speller_new(PyTypeObject * type, PyObject * args, PyObject * kwds)
+{
+	Speller * self;
+	self = (Speller *)type->tp_alloc(type, 0);
+	if (self != nullptr)
+	{
+		self->backends = nullptr;
+		self->lexicon = nullptr;
+		self->sub_table = nullptr;
+		self->filter = nullptr;
+		self->index = nullptr;
+		self->deletions = nullptr;
+		self->frequencies = nullptr;
+		self->caches = nullptr;
+		self->stats = nullptr;
+		self->strings = nullptr;
+		self->background = nullptr;
+	}
+	return (PyObject *)self;
+}
+
+/**
+ * Where data derived from a dictionary, such as its index, may be stored: the given
+ * directory, or else next to the dictionary and then in the user's cache directory.
+ */
+static std::vector<std::filesystem::path> derived_file_locations(const std::filesystem::path & dic_path, const char * cache_dir, const std::string & extension)
+{
+	std::vector<std::filesystem::path> locations;
+	std::string name = dic_path.stem().string();
+	std::error_code ec;
+	std::string unique_name = name + "-" + std::to_string(orthographic_index::hash(std::filesystem::absolute(dic_path, ec).string())) + extension;
+
+	if (cache_dir)
+	{
+		locations.push_back(std::filesystem::u8path(cache_dir) / unique_name);
+		return locations;
+	}
+
+	locations.push_back(dic_path.parent_path() / (name + extension));
+	if (const char * xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg)
+	{
+		locations.push_back(std::filesystem::path(xdg) / "sibel" / unique_name);
+	}
+	else if (const char * home = std::getenv("HOME"); home && *home)
+	{
+		locations.push_back(std::filesystem::path(home) / ".cache" / "sibel" / unique_name);
+	}
+	return locations;
+}
+
+/**
+ * Reads cache_size, either one capacity for every method or a dict from method name to capacity.
+ */
+static bool parse_cache_sizes(PyObject * cache_size, std::size_t sizes[])
+{
+	for (std::size_t i = 0; i < std::size(CACHED_METHODS); ++i)
+	{
+		sizes[i] = 0;
+	}
+	if (cache_size == nullptr || cache_size == Py_None)
+	{
+		return true;
+	}
+
+	if (PyLong_Check(cache_size))
+	{
+		std::size_t size = PyLong_AsSize_t(cache_size);
+		if (PyErr_Occurred())
+		{
+			return false;
+		}
+		for (std::size_t i = 0; i < std::size(CACHED_METHODS); ++i)
+		{
+			sizes[i] = size;
+		}
+		return true;
+	}
+
+	if (!PyDict_Check(cache_size))
+	{
+		PyErr_SetString(PyExc_TypeError, "cache_size must be an int or a dict");
+		return false;
+	}
+
+	PyObject * key;
+	PyObject * value;
+	Py_ssize_t pos = 0;
+	while (PyDict_Next(cache_size, &pos, &key, &value))
+	{
+		const char * name = PyUnicode_Check(key) ? PyUnicode_AsUTF8(key) : nullptr;
+		std::size_t i = 0;
+		while (name && i < std::size(CACHED_METHODS) && std::strcmp(name, CACHED_METHODS[i]) != 0)
+		{
+			++i;
+		}
+		if (name == nullptr || i == std::size(CACHED_METHODS))
+		{
+			PyErr_Format(PyExc_ValueError, "No cache for %R", key);
+			return false;
+		}
+		sizes[i] = PyLong_AsSize_t(value);
+		if (PyErr_Occurred())
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static int Speller_init(Speller * self, PyObject * args, PyObject * kwds)
+{
+	static const char * kwlist[] = { "base_path", "lang_code", "prune_candidates", "orthographic_index", "cache_dir", "threads", "cache_size", "substitution_table", "lazy", "word_set", "suggestion_index", "frequencies", nullptr };
+	const char * buf_base_path;
+	const char * buf_lang_code;
+	int prune_candidates = 0;
+	int build_index = 0;
+	const char * buf_cache_dir = nullptr;
+	Py_ssize_t threads = 1;
+	PyObject * cache_size = nullptr;
+	const char * buf_table_path = nullptr;
+	int lazy = 0;
+	int build_word_set = 0;
+	int build_deletions = 0;
+	const char * buf_frequencies_path = nullptr;
+	std::size_t cache_sizes[std::size(CACHED_METHODS)];
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "ss|ppznOzpppz", const_cast<char **>(kwlist), &buf_base_path, &buf_lang_code, &prune_candidates, &build_index, &buf_cache_dir, &threads, &cache_size, &buf_table_path, &lazy, &build_word_set, &build_deletions, &buf_frequencies_path))
+	{
+		return -1;
+	}
+	if (!parse_cache_sizes(cache_size, cache_sizes))
+	{
+		return -1;
+	}
+	if (threads < 1)
+	{
+		PyErr_SetString(PyExc_ValueError, "A speller needs at least one thread");
+		return -1;
+	}
+
+	std::string lang_code(buf_lang_code);
+	if (buf_table_path)
+	{
+		std::string error;
+		self->sub_table = substitution_table::load(std::filesystem::u8path(buf_table_path), error);
+		if (!self->sub_table)
+		{
+			PyErr_SetString(PyExc_ValueError, error.c_str());
+			return -1;
+		}
+	}
+	else
+	{
+		self->sub_table = substitution_table::find(std::string_view(lang_code).substr(0, 2));
+	}
+
+	std::filesystem::path base_path = std::filesystem::u8path(buf_base_path);
+	std::filesystem::path aff_path = base_path / (lang_code + ".aff");
+	std::filesystem::path dic_path = base_path / (lang_code + ".dic");
+
+	if (!std::filesystem::exists(aff_path))
+	{
+		PyErr_SetString(DictionaryLoadingError, "The .aff file does not exist");
+		return -1;
+	}
+	if (!std::filesystem::exists(dic_path))
+	{
+		PyErr_SetString(DictionaryLoadingError, "The .dic file does not exist");
+		return -1;
+	}
+	std::filesystem::path frequencies_path;
+	if (buf_frequencies_path)
+	{
+		frequencies_path = std::filesystem::u8path(buf_frequencies_path);
+		if (!std::filesystem::exists(frequencies_path))
+		{
+			PyErr_SetString(PyExc_ValueError, "The frequency list does not exist");
+			return -1;
+		}
+	}
+
+	self->caches = new result_caches(cache_sizes[0], cache_sizes[1], cache_sizes[2], cache_sizes[3], cache_sizes[4]);
+	self->stats = new speller_stats();
+	self->strings = new string_interner();
+	self->background = new task_group();
+
+	std::string frequencies_error;
+	Py_BEGIN_ALLOW_THREADS
+	self->backends = new backend_replicas(hunspell_backend::loader(aff_path, dic_path), threads, lazy);
+
+	std::vector<std::filesystem::path> index_paths;
+	if (build_index)
+	{
+		index_paths = derived_file_locations(dic_path, buf_cache_dir, ".sibel-index");
+		for (const std::filesystem::path & location : index_paths)
+		{
+			if ((self->index = orthographic_index::open(location, aff_path, dic_path)))
+			{
+				break;
+			}
+		}
+	}
+
+	// Enumerating the dictionary is only worth it if there is a table to prune
+	prune_candidates = prune_candidates && self->sub_table;
+	std::vector<std::filesystem::path> filter_paths;
+	if (prune_candidates)
+	{
+		filter_paths = derived_file_locations(dic_path, buf_cache_dir, ".sibel-filter");
+		for (const std::filesystem::path & location : filter_paths)
+		{
+			if ((self->filter = prefix_filter::open(location, aff_path, dic_path)))
+			{
+				break;
+			}
+		}
+	}
+
+	std::vector<std::filesystem::path> word_set_paths;
+	if (build_word_set)
+	{
+		word_set_paths = derived_file_locations(dic_path, buf_cache_dir, ".sibel-words");
+		for (const std::filesystem::path & location : word_set_paths)
+		{
+			if ((self->lexicon = word_set::open(location, aff_path, dic_path)))
+			{
+				break;
+			}
+		}
+	}
+
+	std::vector<std::filesystem::path> deletion_paths;
+	if (build_deletions)
+	{
+		deletion_paths = derived_file_locations(dic_path, buf_cache_dir, ".sibel-deletions");
+		for (const std::filesystem::path & location : deletion_paths)
+		{
+			if ((self->deletions = deletion_index::open(location, aff_path, dic_path)))
+			{
+				break;
+			}
+		}
+	}
+
+	if ((prune_candidates && !self->filter) || (build_index && !self->index) || (build_word_set && !self->lexicon) || (build_deletions && !self->deletions))
+	{
+		affix_dictionary dictionary(aff_path, dic_path);
+		if (prune_candidates && !self->filter)
+		{
+			self->filter = prefix_filter::build(dictionary);
+			for (const std::filesystem::path & location : filter_paths)
+			{
+				if (self->filter && self->filter->save(location, aff_path, dic_path))
+				{
+					break;
+				}
+			}
+		}
+		if (build_index && !self->index)
+		{
+			self->index = orthographic_index::build(dictionary);
+			for (const std::filesystem::path & location : index_paths)
+			{
+				if (self->index && self->index->save(location, aff_path, dic_path))
+				{
+					break;
+				}
+			}
+		}
+		if (build_word_set && !self->lexicon)
+		{
+			self->lexicon = word_set::build(dictionary, *self->backends->acquire());
+			for (const std::filesystem::path & location : word_set_paths)
+			{
+				if (self->lexicon && self->lexicon->save(location, aff_path, dic_path))
+				{
+					break;
+				}
+			}
+		}
+		if (build_deletions && !self->deletions)
+		{
+			self->deletions = deletion_index::build(dictionary);
+			for (const std::filesystem::path & location : deletion_paths)
+			{
+				if (self->deletions && self->deletions->save(location, aff_path, dic_path))
+				{
+					break;
+				}
+			}
+		}
+	}
+
+	if (buf_frequencies_path)
+	{
+		std::vector<std::filesystem::path> frequencies_paths = derived_file_locations(frequencies_path, buf_cache_dir, ".sibel-freq");
+		for (const std::filesystem::path & location : frequencies_paths)
+		{
+			if ((self->frequencies = word_frequencies::open(location, frequencies_path)))
+			{
+				break;
+			}
+		}
+		if (!self->frequencies && (self->frequencies = word_frequencies::build(frequencies_path, frequencies_error)))
+		{
+			for (const std::filesystem::path & location : frequencies_paths)
+			{
+				if (self->frequencies->save(location, frequencies_path))
+				{
+					break;
+				}
+			}
+		}
+	}
+	Py_END_ALLOW_THREADS
+
+	if (buf_frequencies_path && !self->frequencies)
+	{
+		PyErr_SetString(PyExc_ValueError, frequencies_error.c_str());
+		return -1;
+	}
+	return 0;
+}
+
+static void Speller_dealloc(Speller * self)
+{
+	if (self->background)
+	{
+		Py_BEGIN_ALLOW_THREADS
+		self->background->wait();
+		Py_END_ALLOW_THREADS
+		delete self->background;
+	}
+	delete self->backends;
+	delete self->lexicon;
+	delete self->filter;
+	delete self->index;
+	delete self->deletions;
+	delete self->frequencies;
+	delete self->caches;
+	delete self->stats;
+	delete self->strings;
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/**
+ * Reads the only argument of a METH_FASTCALL method as a view of the UTF-8 form cached
+ * in the str object, which lives as long as the call.
+ */
+static bool word_argument(const char * method, PyObject * const * args, Py_ssize_t nargs, std::string_view & word)
+{
+	if (nargs != 1)
+	{
+		PyErr_Format(PyExc_TypeError, "%s() takes exactly one argument (%zd given)", method, nargs);
+		return false;
+	}
+	if (!PyUnicode_Check(args[0]))
+	{
+		PyErr_Format(PyExc_TypeError, "%s() argument must be str, not %.50s", method, Py_TYPE(args[0])->tp_name);
+		return false;
+	}
+
+	Py_ssize_t size;
+	const char * buf = PyUnicode_AsUTF8AndSize(args[0], &size);
+	if (buf == nullptr)
+	{
+		return false;
+	}
+	if (std::memchr(buf, '\0', size) != nullptr)
+	{
+		PyErr_SetString(PyExc_ValueError, "embedded null character");
+		return false;
+	}
+	word = std::string_view(buf, size);
+	return true;
+}
+
+/**
+ * Reads the only argument of a METH_FASTCALL method, an iterable.
+ */
+static PyObject * iterable_argument(const char * method, PyObject * const * args, Py_ssize_t nargs)
+{
+	if (nargs != 1)
+	{
+		PyErr_Format(PyExc_TypeError, "%s() takes exactly one argument (%zd given)", method, nargs);
+		return nullptr;
+	}
+	return args[0];
+}
+
+/**
+ * Reads the arguments of a METH_FASTCALL | METH_KEYWORDS method taking
+ * (word, max_results=None, timeout_ms=None, top_k=None), with engine='hunspell' before
+ * top_k if engine is given. limited is set if max_results or timeout_ms is given.
+ */
+static bool limited_word_arguments(const char * method, PyObject * const * args, Py_ssize_t nargs, PyObject * kwnames, std::string_view & word, call_limits & limits, bool & limited, suggestion_engine * engine = nullptr)
+{
+	static const char * names[] = { "word", "max_results", "timeout_ms", "engine", "top_k" };
+	PyObject * values[std::size(names)] = {};
+
+	// The names this method takes, in the order of its parameters
+	std::size_t taken[std::size(names)] = { 0, 1, 2 };
+	std::size_t n_taken = 3;
+	if (engine)
+	{
+		taken[n_taken++] = 3;
+	}
+	taken[n_taken++] = 4;
+
+	if (nargs > static_cast<Py_ssize_t>(n_taken))
+	{
+		PyErr_Format(PyExc_TypeError, "%s() takes at most %zu arguments (%zd given)", method, n_taken, nargs);
+		return false;
+	}
+	for (Py_ssize_t k = 0; k < nargs; ++k)
+	{
+		values[taken[k]] = args[k];
+	}
+
+	Py_ssize_t n_kwargs = kwnames ? PyTuple_GET_SIZE(kwnames) : 0;
+	for (Py_ssize_t k = 0; k < n_kwargs; ++k)
+	{
+		PyObject * name = PyTuple_GET_ITEM(kwnames, k);
+		std::size_t t = 0;
+		while (t < n_taken && PyUnicode_CompareWithASCIIString(name, names[taken[t]]) != 0)
+		{
+			++t;
+		}
+		if (t == n_taken)
+		{
+			PyErr_Format(PyExc_TypeError, "%s() got an unexpected keyword argument '%U'", method, name);
+			return false;
+		}
+		std::size_t i = taken[t];
+		if (values[i])
+		{
+			PyErr_Format(PyExc_TypeError, "%s() got multiple values for argument '%s'", method, names[i]);
+			return false;
+		}
+		values[i] = args[nargs + k];
+	}
+
+	if (values[0] == nullptr)
+	{
+		PyErr_Format(PyExc_TypeError, "%s() missing required argument 'word'", method);
+		return false;
+	}
+	if (!word_argument(method, values, 1, word))
+	{
+		return false;
+	}
+
+	limited = false;
+	if (values[1] && values[1] != Py_None)
+	{
+		Py_ssize_t max_results = PyLong_AsSsize_t(values[1]);
+		if (max_results == -1 && PyErr_Occurred())
+		{
+			return false;
+		}
+		if (max_results < 0)
+		{
+			PyErr_SetString(PyExc_ValueError, "max_results must not be negative");
+			return false;
+		}
+		limits.max_results = max_results;
+		limited = true;
+	}
+	if (values[2] && values[2] != Py_None)
+	{
+		double timeout_ms = PyFloat_AsDouble(values[2]);
+		if (timeout_ms == -1.0 && PyErr_Occurred())
+		{
+			return false;
+		}
+		if (!(timeout_ms >= 0))
+		{
+			PyErr_SetString(PyExc_ValueError, "timeout_ms must not be negative");
+			return false;
+		}
+		// Far enough to mean no deadline, and near enough not to overflow
+		limits.deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(std::min(timeout_ms, 1e12)));
+		limited = true;
+	}
+	if (values[4] && values[4] != Py_None)
+	{
+		Py_ssize_t top_k = PyLong_AsSsize_t(values[4]);
+		if (top_k == -1 && PyErr_Occurred())
+		{
+			return false;
+		}
+		if (top_k < 0)
+		{
+			PyErr_SetString(PyExc_ValueError, "top_k must not be negative");
+			return false;
+		}
+		limits.top_k = top_k;
+	}
+	if (engine)
+	{
+		*engine = suggestion_engine::hunspell;
+		if (values[3] && PyUnicode_Check(values[3]) && PyUnicode_CompareWithASCIIString(values[3], "fast") == 0)
+		{
+			*engine = suggestion_engine::fast;
+		}
+		else if (values[3] && !(PyUnicode_Check(values[3]) && PyUnicode_CompareWithASCIIString(values[3], "hunspell") == 0))
+		{
+			PyErr_Format(PyExc_ValueError, "%s() engine must be 'hunspell' or 'fast'", method);
+			return false;
+		}
+	}
+	return true;
+}
+
+static PyObject * string_list(const std::vector<std::string> & strings, string_interner & interner)
+{
+	PyObject * list = PyList_New(strings.size());
+	if (list == nullptr)
+	{
+		return nullptr;
+	}
+	for (std::size_t i = 0; i < strings.size(); ++i)
+	{
+		PyObject * s = interner.get(strings[i]);
+		if (s == nullptr)
+		{
+			Py_DECREF(list);
+			return nullptr;
+		}
+		PyList_SET_ITEM(list, i, s);
+	}
+	return list;
+}
+
+/**
+ * Returns a ResultList of the first max_results strings.
+ */
+static PyObject * result_list(const std::vector<std::string> & strings, std::size_t max_results, bool partial, string_interner & interner)
+{
+	PyObject * list = PyObject_CallObject((PyObject *)&ResultListType, nullptr);
+	if (list == nullptr)
+	{
+		return nullptr;
+	}
+	((ResultList *)list)->partial = partial;
+	for (std::size_t i = 0; i < std::min(strings.size(), max_results); ++i)
+	{
+		PyObject * s = interner.get(strings[i]);
+		if (s == nullptr || PyList_Append(list, s) < 0)
+		{
+			Py_XDECREF(s);
+			Py_DECREF(list);
+			return nullptr;
+		}
+		Py_DECREF(s);
+	}
+	return list;
+}
+
+/**
+ * A plain list unless the call was given limits.
+ */
+static PyObject * limited_result(Speller * self, const std::vector<std::string> & strings, const call_limits & limits, bool limited, bool partial)
+{
+	if (!limited)
+	{
+		return string_list(strings, *self->strings);
+	}
+	if (partial)
+	{
+		count(self, &speller_stats::partial_results, 1);
+	}
+	return result_list(strings, limits.max_results, partial, *self->strings);
+}
+
+/**
+ * Whether word is spelt correctly, asking the backend only if the word set does not know.
+ */
+static bool spelt_correctly(Speller * self, spelling_backend & backend, const std::string & word)
+{
+	if (self->lexicon && self->lexicon->contains(word))
+	{
+		count(self, &speller_stats::word_set_hits, 1);
+		return true;
+	}
+	return backend.spell(word);
+}
+
+/**
+ * The same, only borrowing a replica of the backend when it is needed.
+ */
+static bool spelt_correctly(Speller * self, const std::string & word)
+{
+	if (self->lexicon && self->lexicon->contains(word))
+	{
+		count(self, &speller_stats::word_set_hits, 1);
+		return true;
+	}
+	return self->backends->acquire()->spell(word);
+}
+
+static PyObject * Speller_spell(Speller * self, PyObject * const * args, Py_ssize_t nargs)
+{
+	stats_timer timer = time_method(self, timed_method::spell);
+	std::string_view word_view;
+	if (!word_argument("spell", args, nargs, word_view))
+	{
+		return nullptr;
+	}
+
+	const std::string word(word_view);
+	bool ok;
+	
+	BEGIN_WITHOUT_GIL(self)
+	ok = cached(self->caches->spell, word, [&]
+	{
+		return spelt_correctly(self, word);
+	});
+	END_WITHOUT_GIL
+
+	if (ok)
+	{
+		Py_RETURN_TRUE;
+	}
+	else
+	{
+		Py_RETURN_FALSE;
+	}
+}
+
+/**
+ * Suggestions that are quick to find, for a call that has run out of time inside Hunspell:
+ * the words with the same simplified form from the index, the word with its first letter
+ * in the other case, the words from the deletion index and, for ASCII words, the words one
+ * deletion, transposition, replacement or insertion of a letter away. Empty if no replica
+ * is free right away.
+ */
+static std::vector<std::string> quick_suggestions(Speller * self, const std::string & word, std::size_t max_results)
+{
+	std::vector<std::string> suggestions;
+	backend_replicas::lease backend = self->backends->acquire_until(std::chrono::steady_clock::now());
+	if (!backend)
+	{
+		return suggestions;
+	}
+
+	std::unordered_set<std::string> seen{word};
+	std::uint64_t checked = 0;
+	// Returns false once no more candidates are wanted
+	auto offer = [&](const std::string & candidate)
+	{
+		if (seen.insert(candidate).second)
+		{
+			++checked;
+			if (spelt_correctly(self, *backend, candidate))
+			{
+				suggestions.push_back(candidate);
+			}
+		}
+		return suggestions.size() < max_results && checked < QUICK_CANDIDATE_LIMIT;
+	};
+	auto offer_all = [&offer](const std::vector<std::string> & candidates)
+	{
+		return std::all_of(candidates.cbegin(), candidates.cend(), offer);
+	};
+
+	std::vector<std::string> candidates;
+	if (self->index)
+	{
+		candidates = self->index->candidates(word);
+	}
+	if (!word.empty() && std::isalpha(static_cast<unsigned char>(word[0])))
+	{
+		std::string other_case = word;
+		other_case[0] = std::isupper(static_cast<unsigned char>(word[0])) ? std::tolower(static_cast<unsigned char>(word[0])) : std::toupper(static_cast<unsigned char>(word[0]));
+		candidates.push_back(std::move(other_case));
+	}
+	if (self->deletions)
+	{
+		std::vector<std::string> nearby = self->deletions->nearby(word);
+		std::move(nearby.begin(), nearby.end(), std::back_inserter(candidates));
+	}
+	bool more = max_results > 0 && offer_all(candidates);
+
+	if (more && classify(word).ascii)
+	{
+		static const std::string_view LETTERS = "abcdefghijklmnopqrstuvwxyz";
+		std::string candidate;
+		for (std::size_t i = 0; more && i < word.size(); ++i)
+		{
+			candidate = word;
+			candidate.erase(i, 1);
+			more = offer(candidate);
+		}
+		for (std::size_t i = 0; more && i + 1 < word.size(); ++i)
+		{
+			candidate = word;
+			std::swap(candidate[i], candidate[i + 1]);
+			more = offer(candidate);
+		}
+		for (std::size_t i = 0; more && i < word.size(); ++i)
+		{
+			for (std::size_t j = 0; more && j < LETTERS.size(); ++j)
+			{
+				candidate = word;
+				candidate[i] = LETTERS[j];
+				more = offer(candidate);
+			}
+		}
+		for (std::size_t i = 0; more && i <= word.size(); ++i)
+		{
+			for (std::size_t j = 0; more && j < LETTERS.size(); ++j)
+			{
+				candidate = word;
+				candidate.insert(i, 1, LETTERS[j]);
+				more = offer(candidate);
+			}
+		}
+	}
+
+	count(self, &speller_stats::candidates_checked, checked);
+	return suggestions;
+}
+
+/**
+ * Hunspell's suggestions for word, cached. Hunspell cannot be stopped, so with a deadline
+ * it runs in the background while the caller waits. If the deadline passes first, partial
+ * is set and the caller gets quick_suggestions() instead; Hunspell's answer still goes in
+ * the cache when it comes. Without pool threads there is nothing to run it on, and the
+ * deadline is ignored.
+ */
+static std::vector<std::string> suggest_within(Speller * self, const std::string & word, const call_limits & limits, bool & partial)
+{
+	std::vector<std::string> suggestions;
+	std::uint64_t generation = 0;
+	if (self->caches->suggest.get(word, suggestions, generation))
+	{
+		return suggestions;
+	}
+
+	if (!limits.deadline || thread_pool::instance().size() == 0)
+	{
+		suggestions = self->backends->acquire()->suggest(word);
+		self->caches->suggest.put(word, suggestions, generation);
+		return suggestions;
+	}
+
+	struct background_suggestions
+	{
+		std::mutex mtx;
+		std::condition_variable cv;
+		bool done = false;
+		std::vector<std::string> suggestions;
+	};
+
+	auto job = std::make_shared<background_suggestions>();
+	self->background->run([self, word, generation, job]
+	{
+		std::vector<std::string> suggestions = self->backends->acquire()->suggest(word);
+		self->caches->suggest.put(word, suggestions, generation);
+		std::lock_guard<std::mutex> lock(job->mtx);
+		job->suggestions = std::move(suggestions);
+		job->done = true;
+		job->cv.notify_all();
+	});
+
+	{
+		std::unique_lock<std::mutex> lock(job->mtx);
+		if (job->cv.wait_until(lock, *limits.deadline, [&job] { return job->done; }))
+		{
+			return std::move(job->suggestions);
+		}
+	}
+
+	partial = true;
+	return quick_suggestions(self, word, limits.max_results);
+}
+
+/**
+ * The forms the deletion index finds near word, nearest and then most frequent first, that
+ * the backend accepts: the index holds forms valid only in some other way too, e.g. before
+ * another affix. Unless max_results is given, no more than Hunspell would give.
+ */
+static std::vector<std::string> indexed_suggestions(Speller * self, const std::string & word, const call_limits & limits)
+{
+	std::size_t max_results = limits.max_results == SIZE_MAX ? INDEXED_SUGGESTION_LIMIT : limits.max_results;
+	max_results = std::min(max_results, limits.top_k);
+	std::vector<std::string> suggestions;
+	for (std::string & form : self->deletions->nearby(word, self->frequencies))
+	{
+		if (suggestions.size() >= max_results)
+		{
+			break;
+		}
+		if (spelt_correctly(self, form))
+		{
+			suggestions.push_back(std::move(form));
+		}
+	}
+	return suggestions;
+}
+
+/**
+ * Checks that the engine asked for is there before the call goes any further.
+ */
+static bool engine_available(Speller * self, suggestion_engine engine)
+{
+	if (engine == suggestion_engine::fast && !self->deletions)
+	{
+		PyErr_SetString(PyExc_ValueError, "engine='fast' needs a Speller created with suggestion_index=True");
+		return false;
+	}
+	return true;
+}
+
+/**
+ * The suggestions of the engine asked for. Hunspell's own order is kept unless there are
+ * frequencies to rank them by; either way only the first top_k are returned.
+ */
+static std::vector<std::string> suggest_with(Speller * self, const std::string & word, const call_limits & limits, suggestion_engine engine, bool & partial)
+{
+	if (engine == suggestion_engine::fast)
+	{
+		return indexed_suggestions(self, word, limits);
+	}
+	std::vector<std::string> suggestions = suggest_within(self, word, limits, partial);
+	if (self->frequencies)
+	{
+		self->frequencies->rank(suggestions);
+	}
+	if (suggestions.size() > limits.top_k)
+	{
+		suggestions.resize(limits.top_k);
+	}
+	return suggestions;
+}
+
+static PyObject * Speller_suggest(Speller * self, PyObject * const * args, Py_ssize_t nargs, PyObject * kwnames)
+{
+	stats_timer timer = time_method(self, timed_method::suggest);
+	std::string_view word_view;
+	call_limits limits;
+	bool limited;
+	suggestion_engine engine;
+	if (!limited_word_arguments("suggest", args, nargs, kwnames, word_view, limits, limited, &engine) || !engine_available(self, engine))
+	{
+		return nullptr;
+	}
+
+	const std::string word(word_view);
+	std::vector<std::string> suggestions;
+	bool partial = false;
+
+	BEGIN_WITHOUT_GIL(self)
+	suggestions = suggest_with(self, word, limits, engine, partial);
+	END_WITHOUT_GIL
+
+	return limited_result(self, suggestions, limits, limited, partial);
+}
+
+static PyObject * Speller_analyse(Speller * self, PyObject * const * args, Py_ssize_t nargs)
+{
+	stats_timer timer = time_method(self, timed_method::analyse);
+	std::string_view word_view;
+	if (!word_argument("analyse", args, nargs, word_view))
+	{
+		return nullptr;
+	}
+
+	const std::string word(word_view);
+	std::vector<std::string> analyses;
+
+	BEGIN_WITHOUT_GIL(self)
+	analyses = cached(self->caches->analyse, word, [&]
+	{
+		return self->backends->acquire()->analyse(word);
+	});
+	END_WITHOUT_GIL
+
+	return string_list(analyses, *self->strings);
+}
+
+static PyObject * Speller_stem(Speller * self, PyObject * const * args, Py_ssize_t nargs)
+{
+	stats_timer timer = time_method(self, timed_method::stem);
+	std::string_view word_view;
+	if (!word_argument("stem", args, nargs, word_view))
+	{
+		return nullptr;
+	}
+
+	const std::string word(word_view);
+	std::vector<std::string> stems;
+
+	BEGIN_WITHOUT_GIL(self)
+	stems = cached(self->caches->stem, word, [&]
+	{
+		return self->backends->acquire()->stem(word);
+	});
+	END_WITHOUT_GIL
+
+	return string_list(stems, *self->strings);
+}
+
+/**
+ * Checks the candidates produced by generate in batches on the shared thread pool
+ * while generation goes on, and keeps the accepted ones in their original order.
+ * accept fills in one flag per candidate of a batch.
+ */
+static std::vector<std::string> check_on_pool(const std::function<void(const std::function<void(const std::string &)> &)> & generate, const std::function<void(const std::vector<std::string> &, std::vector<char> &)> & accept, std::size_t batch_size)
+{
+	struct candidate_batch
+	{
+		std::vector<std::string> candidates;
+		std::vector<char> accepted;
+	};
+
+	std::deque<candidate_batch> batches(1);
+	task_group group;
+
+	auto dispatch = [&](candidate_batch & batch)
+	{
+		group.run([&accept, &batch]
+		{
+			batch.accepted.resize(batch.candidates.size());
+			accept(batch.candidates, batch.accepted);
+		});
+	};
+
+	generate([&](const std::string & candidate)
+	{
+		batches.back().candidates.push_back(candidate);
+		if (batches.back().candidates.size() == batch_size)
+		{
+			dispatch(batches.back());
+			batches.emplace_back();
+		}
+	});
+	dispatch(batches.back());
+	group.wait();
+
+	std::vector<std::string> result;
+	for (candidate_batch & batch : batches)
+	{
+		for (std::size_t i = 0; i < batch.candidates.size(); ++i)
+		{
+			if (batch.accepted[i])
+			{
+				result.push_back(std::move(batch.candidates[i]));
+			}
+		}
+	}
+	return result;
+}
+
+/**
+ * Keeps the candidates accepted by the predicate, in their original order.
+ */
+static std::vector<std::string> filter_on_pool(const std::vector<std::string> & candidates, const std::function<bool(const std::string &)> & predicate)
+{
+	// A few batches per worker, so that idle workers have something to steal
+	std::size_t n_batches = 4 * (thread_pool::instance().size() + 1);
+	std::size_t batch_size = std::max<std::size_t>(1, (candidates.size() + n_batches - 1) / n_batches);
+
+	return check_on_pool([&candidates](const std::function<void(const std::string &)> & yield)
+	{
+		for (const std::string & candidate : candidates)
+		{
+			yield(candidate);
+		}
+	}, [&predicate](const std::vector<std::string> & batch, std::vector<char> & accepted)
+	{
+		for (std::size_t i = 0; i < batch.size(); ++i)
+		{
+			accepted[i] = predicate(batch[i]);
+		}
+	}, batch_size);
+}
+
+static bool is_ascii_letters(const std::string & s)
+{
+	return std::all_of(s.cbegin(), s.cend(), [](unsigned char c)
+	{
+		return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+	});
+}
+
+/**
+ * Checks a batch of candidates against one backend.
+ */
+static void check_candidates(Speller * self, const std::vector<std::string> & batch, std::vector<char> & accepted)
+{
+	backend_replicas::lease backend = self->backends->acquire();
+	for (std::size_t i = 0; i < batch.size(); ++i)
+	{
+		accepted[i] = spelt_correctly(self, *backend, batch[i]);
+	}
+}
+
+/**
+ * The work behind orthographic_forms(), done without the GIL. Once the deadline has
+ * passed, no more candidates are generated and partial is set. With top_k, candidates
+ * are checked best first and checking stops once top_k of them are found, so the result
+ * may be short of the whole.
+ */
+static std::vector<std::string> find_orthographic_forms(Speller * self, const std::string & word, const call_limits & limits, bool & partial)
+{
+	std::vector<std::string> forms;
+
+	if (!substitution_table::is_substitutable(word))
+	{
+		count(self, orthographic_path::not_substitutable);
+		count(self, &speller_stats::candidates_checked, 1);
+		if (spelt_correctly(self, word))
+		{
+			forms.push_back(word);
+		}
+		return forms;
+	}
+
+	// Hunspell also accepts hyphenated words, numbers and so on, which the filter knows nothing about
+	const prefix_filter * filter = is_ascii_letters(word) ? self->filter : nullptr;
+	std::string::size_type max_length = filter ? substitution_table::PRUNED_SUBSTITUTION_MAX_LENGTH : self->sub_table ? self->sub_table->max_length() : 0;
+	bool use_table = self->sub_table && word.size() <= max_length;
+
+	// What the index found, if the table may still find more
+	std::vector<std::string> indexed;
+	if (self->index)
+	{
+		backend_replicas::lease backend = self->backends->acquire();
+		std::vector<std::string> candidates = self->index->candidates(word);
+		if (self->frequencies && limits.top_k != SIZE_MAX)
+		{
+			self->frequencies->rank(candidates);
+		}
+		std::size_t checked = 0;
+		for (const std::string & candidate : candidates)
+		{
+			if (forms.size() >= limits.top_k)
+			{
+				break;
+			}
+			++checked;
+			if (spelt_correctly(self, *backend, candidate))
+			{
+				forms.push_back(candidate);
+			}
+		}
+		count(self, &speller_stats::candidates_generated, candidates.size());
+		count(self, &speller_stats::candidates_checked, checked);
+
+		// Compounds are not in the index, so a miss goes on to the other methods, and so does
+		// a hit unless the index holds every form of the key: the parts of a hyphenated word
+		// are looked up on their own
+		if (!forms.empty())
+		{
+			if (!use_table || (self->index->exhaustive() && word.find('-') == std::string::npos))
+			{
+				count(self, orthographic_path::index);
+				return forms;
+			}
+			indexed.swap(forms);
+		}
+	}
+
+	if (use_table)
+	{
+		// Only touched by the generating thread
+		std::uint64_t generated = 0;
+		std::uint64_t pruned = 0;
+		std::function<bool(const std::string &)> viable;
+		if (filter || limits.deadline)
+		{
+			viable = [filter, &pruned, &limits, &partial](const std::string & prefix)
+			{
+				if (partial || limits.expired())
+				{
+					partial = true;
+					return false;
+				}
+				if (!filter || filter->viable(prefix))
+				{
+					return true;
+				}
+				++pruned;
+				return false;
+			};
+		}
+
+		auto check = [self](const std::vector<std::string> & batch, std::vector<char> & accepted)
+		{
+			check_candidates(self, batch, accepted);
+		};
+
+		std::uint64_t checked = 0;
+		if (limits.top_k == SIZE_MAX)
+		{
+			forms = check_on_pool([&](const std::function<void(const std::string &)> & yield)
+			{
+				self->sub_table->for_each_substitution(word, [&](const std::string & candidate)
+				{
+					++generated;
+					yield(candidate);
+				}, viable);
+			}, check, CANDIDATE_BATCH_SIZE);
+			checked = generated;
+		}
+		else
+		{
+			std::vector<std::string> candidates;
+			self->sub_table->for_each_substitution(word, [&](const std::string & candidate)
+			{
+				++generated;
+				candidates.push_back(candidate);
+			}, viable);
+			if (self->frequencies)
+			{
+				self->frequencies->rank(candidates);
+			}
+
+			// A batch per worker at a time, so that little is checked past the top_k-th form
+			std::size_t window = CANDIDATE_BATCH_SIZE * (thread_pool::instance().size() + 1);
+			for (std::size_t from = 0; from < candidates.size() && forms.size() < limits.top_k; from += window)
+			{
+				if (limits.expired())
+				{
+					partial = true;
+					break;
+				}
+				std::size_t to = std::min(candidates.size(), from + window);
+				std::vector<std::string> found = check_on_pool([&](const std::function<void(const std::string &)> & yield)
+				{
+					for (std::size_t i = from; i < to; ++i)
+					{
+						yield(candidates[i]);
+					}
+				}, check, CANDIDATE_BATCH_SIZE);
+				checked += to - from;
+				for (std::string & form : found)
+				{
+					forms.push_back(std::move(form));
+				}
+			}
+		}
+
+		for (std::string & form : indexed)
+		{
+			if (std::find(forms.begin(), forms.end(), form) == forms.end())
+			{
+				forms.push_back(std::move(form));
+			}
+		}
+
+		count(self, orthographic_path::substitution_table);
+		count(self, &speller_stats::candidates_generated, generated);
+		count(self, &speller_stats::candidates_pruned, pruned);
+		count(self, &speller_stats::candidates_checked, checked);
+	}
+	else
+	{
+		std::string word_simplified(simplify(word));
+		auto same_simplified = [&word_simplified](const std::string & s)
+		{
+			thread_local std::string simplified;
+			if (!is_without_banned_chars(s))
+			{
+				return false;
+			}
+			simplify(s, simplified);
+			return simplified == word_simplified;
+		};
+
+		// The deletion index only reaches two edits away, so a miss still asks Hunspell
+		if (self->deletions)
+		{
+			std::vector<std::string> nearby = self->deletions->nearby(word, self->frequencies);
+			nearby.erase(std::remove_if(nearby.begin(), nearby.end(), [&](const std::string & s)
+			{
+				return !same_simplified(s);
+			}), nearby.end());
+			count(self, &speller_stats::candidates_generated, nearby.size());
+			count(self, &speller_stats::candidates_checked, nearby.size());
+			for (std::string & form : nearby)
+			{
+				if (spelt_correctly(self, form))
+				{
+					forms.push_back(std::move(form));
+				}
+			}
+			if (!forms.empty())
+			{
+				count(self, orthographic_path::suggestion_index);
+				return forms;
+			}
+		}
+
+		std::vector<std::string> suggestions = suggest_within(self, word, limits, partial);
+		count(self, orthographic_path::suggest_fallback);
+		count(self, &speller_stats::candidates_generated, suggestions.size());
+
+		forms = filter_on_pool(suggestions, same_simplified);
+	}
+
+	return forms;
+}
+
+/**
+ * find_orthographic_forms(), cached unless the result is partial or cut short by top_k,
+ * which must not stand in for the whole one later. The forms are ranked by frequency if
+ * there are frequencies.
+ */
+static std::vector<std::string> orthographic_forms_within(Speller * self, const std::string & word, const call_limits & limits, bool & partial)
+{
+	std::vector<std::string> forms;
+	std::uint64_t generation = 0;
+	if (!self->caches->orthographic_forms.get(word, forms, generation))
+	{
+		forms = find_orthographic_forms(self, word, limits, partial);
+		if (!partial && limits.top_k == SIZE_MAX)
+		{
+			self->caches->orthographic_forms.put(word, forms, generation);
+		}
+	}
+	if (self->frequencies)
+	{
+		self->frequencies->rank(forms);
+	}
+	if (forms.size() > limits.top_k)
+	{
+		forms.resize(limits.top_k);
+	}
+	return forms;
+}
+
+static PyObject * Speller_orthographic_forms(Speller * self, PyObject * const * args, Py_ssize_t nargs, PyObject * kwnames)
+{
+	stats_timer timer = time_method(self, timed_method::orthographic_forms);
+	std::string_view word_view;
+	call_limits limits;
+	bool limited;
+	if (!limited_word_arguments("orthographic_forms", args, nargs, kwnames, word_view, limits, limited))
+	{
+		return nullptr;
+	}
+
+	const std::string word(word_view);
+	std::vector<std::string> forms;
+	bool partial = false;
+
+	BEGIN_WITHOUT_GIL(self)
+	forms = orthographic_forms_within(self, word, limits, partial);
+	END_WITHOUT_GIL
+
+	return limited_result(self, forms, limits, limited, partial);
+}
+
+/**
+ * Converts every item of an iterable of str to UTF-8 up front, so that a whole batch
+ * can then be processed without the GIL.
+ */
+static bool utf8_words(PyObject * iterable, std::vector<std::string> & words)
+{
+	PyObject * seq = PySequence_Fast(iterable, "Expected an iterable of str");
+	if (seq == nullptr)
+	{
+		return false;
+	}
+
+	Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+	PyObject ** items = PySequence_Fast_ITEMS(seq);
+	words.reserve(n);
+	for (Py_ssize_t i = 0; i < n; ++i)
+	{
+		Py_ssize_t size;
+		const char * buf = PyUnicode_AsUTF8AndSize(items[i], &size);
+		if (buf == nullptr)
+		{
+			Py_DECREF(seq);
+			return false;
+		}
+		words.emplace_back(buf, size);
+	}
+
+	Py_DECREF(seq);
+	return true;
+}
+
+/**
+ * Calls process for every index below n, splitting the range into one contiguous chunk
+ * per replica of the backend. The chunks run in parallel on the shared thread pool.
+ */
+static void for_each_on_replicas(Speller * self, std::size_t n, const std::function<void(std::size_t, spelling_backend &)> & process)
+{
+	std::size_t n_chunks = std::min(self->backends->size(), n);
+	if (n_chunks <= 1)
+	{
+		backend_replicas::lease backend = self->backends->acquire();
+		for (std::size_t i = 0; i < n; ++i)
+		{
+			process(i, *backend);
+		}
+		return;
+	}
+
+	task_group group;
+	for (std::size_t chunk = 0; chunk < n_chunks; ++chunk)
+	{
+		std::size_t begin = n * chunk / n_chunks;
+		std::size_t end = n * (chunk + 1) / n_chunks;
+		group.run([self, &process, begin, end]
+		{
+			backend_replicas::lease backend = self->backends->acquire();
+			for (std::size_t i = begin; i < end; ++i)
+			{
+				process(i, *backend);
+			}
+		});
+	}
+	group.wait();
+}
+
+static PyObject * Speller_spell_many(Speller * self, PyObject * const * args, Py_ssize_t nargs)
+{
+	stats_timer timer = time_method(self, timed_method::spell_many);
+	PyObject * iterable = iterable_argument("spell_many", args, nargs);
+	if (iterable == nullptr)
+	{
+		return nullptr;
+	}
+
+	std::vector<std::string> words;
+	if (!utf8_words(iterable, words))
+	{
+		return nullptr;
+	}
+
+	PyObject * results = PyBytes_FromStringAndSize(nullptr, words.size());
+	if (results == nullptr)
+	{
+		return nullptr;
+	}
+	char * flags = PyBytes_AS_STRING(results);
+
+	BEGIN_WITHOUT_GIL(self)
+	for_each_on_replicas(self, words.size(), [&](std::size_t i, spelling_backend & backend)
+	{
+		flags[i] = cached(self->caches->spell, words[i], [&]
+		{
+			return spelt_correctly(self, backend, words[i]);
+		});
+	});
+	END_WITHOUT_GIL
+
+	return results;
+}
+
+/**
+ * Applies a list-valued backend method to a batch of words, releasing the GIL once.
+ */
+static PyObject * apply_to_many(Speller * self, PyObject * const * args, Py_ssize_t nargs, std::vector<std::string> (spelling_backend::*method)(const std::string &), clock_cache<std::vector<std::string>> & cache, timed_method timed)
+{
+	stats_timer timer = time_method(self, timed);
+	PyObject * iterable = iterable_argument(TIMED_METHODS[static_cast<std::size_t>(timed)], args, nargs);
+	if (iterable == nullptr)
+	{
+		return nullptr;
+	}
+
+	std::vector<std::string> words;
+	if (!utf8_words(iterable, words))
+	{
+		return nullptr;
+	}
+
+	std::vector<std::vector<std::string>> results(words.size());
+
+	BEGIN_WITHOUT_GIL(self)
+	for_each_on_replicas(self, words.size(), [&](std::size_t i, spelling_backend & backend)
+	{
+		results[i] = cached(cache, words[i], [&]
+		{
+			return (backend.*method)(words[i]);
+		});
+	});
+	END_WITHOUT_GIL
+
+	PyObject * results_list = PyList_New(results.size());
+	if (results_list == nullptr)
+	{
+		return nullptr;
+	}
+	for (std::size_t i = 0; i < results.size(); ++i)
+	{
+		PyObject * item = string_list(results[i], *self->strings);
+		if (item == nullptr)
+		{
+			Py_DECREF(results_list);
+			return nullptr;
+		}
+		PyList_SET_ITEM(results_list, i, item);
+	}
+
+	return results_list;
+}
+
+static PyObject * Speller_suggest_many(Speller * self, PyObject * const * args, Py_ssize_t nargs)
+{
+	return apply_to_many(self, args, nargs, &spelling_backend::suggest, self->caches->suggest, timed_method::suggest_many);
+}
+
+static PyObject * Speller_analyse_many(Speller * self, PyObject * const * args, Py_ssize_t nargs)
+{
+	return apply_to_many(self, args, nargs, &spelling_backend::analyse, self->caches->analyse, timed_method::analyse_many);
+}
+
+static PyObject * Speller_stem_many(Speller * self, PyObject * const * args, Py_ssize_t nargs)
+{
+	return apply_to_many(self, args, nargs, &spelling_backend::stem, self->caches->stem, timed_method::stem_many);
+}
+
+static PyObject * Speller_add(Speller * self, PyObject * const * args, Py_ssize_t nargs)
+{
+	stats_timer timer = time_method(self, timed_method::add);
+	std::string_view word_view;
+	if (!word_argument("add", args, nargs, word_view))
+	{
+		return nullptr;
+	}
+
+	const std::string word(word_view);
+
+	BEGIN_WITHOUT_GIL(self)
+	// Kept to be replayed on replicas loaded later, so it must not refer to anything here
+	self->backends->for_each([word](spelling_backend & backend)
+	{
+		backend.add(word);
+	});
+	if (self->filter)
+	{
+		self->filter->add(word);
+	}
+	if (self->index)
+	{
+		self->index->add(word);
+	}
+	if (self->deletions)
+	{
+		self->deletions->add(word);
+	}
+	// Only once every replica knows the word, so that nothing older can be cached again
+	self->caches->clear();
+	END_WITHOUT_GIL
+
+	Py_RETURN_NONE;
+}
+
+/**
+ * The words of a text and which of them are misspelt. Each distinct word is checked once.
+ */
+struct text_check
+{
+	struct token
+	{
+		std::size_t offset;
+		std::size_t word; // index into words
+	};
+
+	std::vector<token> tokens;
+	std::vector<std::string> words;
+	std::vector<char> correct;
+	std::vector<std::vector<std::string>> suggestions; // empty unless requested
+};
+
+/**
+ * Appends the strings of from not yet in to, keeping their order.
+ */
+static void merge_unique(std::vector<std::string> & to, std::vector<std::string> && from)
+{
+	if (to.empty())
+	{
+		to = std::move(from);
+		return;
+	}
+	std::unordered_set<std::string> seen(to.cbegin(), to.cend());
+	for (std::string & s : from)
+	{
+		if (seen.insert(s).second)
+		{
+			to.push_back(std::move(s));
+		}
+	}
+}
+
+/**
+ * Splits text into words and checks them, without the GIL. A word is correct if any of
+ * the spellers accepts it; each speller only checks the words the ones before it did not
+ * accept. The suggestions of all spellers are merged in order. The offsets are in code
+ * points, or in bytes if byte_offsets is set. Returns false if the text could not be split.
+ */
+static bool check_words(const std::vector<Speller *> & spellers, std::string_view text, bool suggest, bool byte_offsets, text_check & check)
+{
+	std::unordered_map<std::string_view, std::size_t> word_indices;
+	bool segmented = for_each_word(text, [&](std::size_t byte_offset, std::size_t offset, std::string_view word)
+	{
+		auto [it, inserted] = word_indices.emplace(word, check.words.size());
+		if (inserted)
+		{
+			check.words.emplace_back(word);
+		}
+		check.tokens.push_back({ byte_offsets ? byte_offset : offset, it->second });
+	});
+	if (!segmented)
+	{
+		return false;
+	}
+
+	check.correct.resize(check.words.size());
+	std::vector<std::size_t> misspelt(check.words.size());
+	for (std::size_t i = 0; i < misspelt.size(); ++i)
+	{
+		misspelt[i] = i;
+	}
+	for (Speller * speller : spellers)
+	{
+		for_each_on_replicas(speller, misspelt.size(), [&](std::size_t i, spelling_backend & backend)
+		{
+			const std::string & word = check.words[misspelt[i]];
+			check.correct[misspelt[i]] = cached(speller->caches->spell, word, [&]
+			{
+				return spelt_correctly(speller, backend, word);
+			});
+		});
+		misspelt.erase(std::remove_if(misspelt.begin(), misspelt.end(), [&check](std::size_t i)
+		{
+			return check.correct[i];
+		}), misspelt.end());
+	}
+
+	if (suggest)
+	{
+		check.suggestions.resize(check.words.size());
+		for (Speller * speller : spellers)
+		{
+			std::vector<std::vector<std::string>> found(misspelt.size());
+			for_each_on_replicas(speller, misspelt.size(), [&](std::size_t i, spelling_backend & backend)
+			{
+				const std::string & word = check.words[misspelt[i]];
+				found[i] = cached(speller->caches->suggest, word, [&]
+				{
+					return backend.suggest(word);
+				});
+			});
+			for (std::size_t i = 0; i < misspelt.size(); ++i)
+			{
+				merge_unique(check.suggestions[misspelt[i]], std::move(found[i]));
+			}
+		}
+	}
+	return true;
+}
+
+static bool check_words(Speller * self, std::string_view text, bool suggest, bool byte_offsets, text_check & check)
+{
+	return check_words(std::vector<Speller *>{ self }, text, suggest, byte_offsets, check);
+}
+
+/**
+ * (offset, word, suggestions or None) for a misspelt token. The word is decoded leniently,
+ * since a file may contain invalid UTF-8.
+ */
+static PyObject * misspelling_tuple(Speller * self, const text_check & check, const text_check::token & t, std::size_t base_offset, bool suggest)
+{
+	const std::string & w = check.words[t.word];
+	PyObject * word = PyUnicode_DecodeUTF8(w.data(), w.size(), "replace");
+	PyObject * word_suggestions;
+	if (suggest)
+	{
+		word_suggestions = string_list(check.suggestions[t.word], *self->strings);
+	}
+	else
+	{
+		word_suggestions = Py_None;
+		Py_INCREF(Py_None);
+	}
+
+	if (word == nullptr || word_suggestions == nullptr)
+	{
+		Py_XDECREF(word);
+		Py_XDECREF(word_suggestions);
+		return nullptr;
+	}
+	return Py_BuildValue("(nNN)", (Py_ssize_t)(base_offset + t.offset), word, word_suggestions);
+}
+
+/**
+ * The result of check_text(): the misspelt tokens of a checked text, in order.
+ */
+static PyObject * misspellings(Speller * self, const text_check & check, bool segmented, bool suggest)
+{
+	if (!segmented)
+	{
+		PyErr_SetString(PyExc_ValueError, "The text could not be split into words");
+		return nullptr;
+	}
+
+	PyObject * result = PyList_New(0);
+	for (std::size_t i = 0; result && i < check.tokens.size(); ++i)
+	{
+		if (check.correct[check.tokens[i].word])
+		{
+			continue;
+		}
+		PyObject * item = misspelling_tuple(self, check, check.tokens[i], 0, suggest);
+		if (item == nullptr || PyList_Append(result, item) < 0)
+		{
+			Py_CLEAR(result);
+		}
+		Py_XDECREF(item);
+	}
+	return result;
+}
+
+static PyObject * Speller_check_text(Speller * self, PyObject * args, PyObject * kwds)
+{
+	stats_timer timer = time_method(self, timed_method::check_text);
+	static const char * kwlist[] = { "text", "suggest", nullptr };
+	const char * buf_text;
+	Py_ssize_t text_size;
+	int suggest = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "s#|p", const_cast<char **>(kwlist), &buf_text, &text_size, &suggest))
+	{
+		return nullptr;
+	}
+
+	text_check check;
+	bool segmented;
+
+	BEGIN_WITHOUT_GIL(self)
+	segmented = check_words(self, std::string_view(buf_text, text_size), suggest, false, check);
+	END_WITHOUT_GIL
+
+	return misspellings(self, check, segmented, suggest);
+}
+
+/**
+ * The state of a check_file() iterator, shared with the chunk jobs it has submitted.
+ * Chunks end at whitespace, are checked in parallel on the thread pool, and are handed
+ * out in file order; at most window of them are in flight.
+ */
+struct file_check
+{
+	static const std::size_t CHUNK_SIZE = 1 << 20;
+
+	struct chunk
+	{
+		std::size_t begin;
+		std::size_t end;
+		text_check check;
+		bool segmented = false;
+		bool done = false; // guarded by mtx
+	};
+
+	Speller * speller;
+	std::unique_ptr<mapped_file> file;
+	bool suggest;
+	std::size_t window;
+	std::size_t next_begin = 0;
+	std::deque<chunk> in_flight; // only touched by the iterating thread
+	std::size_t position = 0; // next token of the front chunk
+	std::atomic<bool> cancelled{false};
+	std::mutex mtx;
+	std::condition_variable cv;
+	task_group group;
+
+	/**
+	 * Where the chunk starting at begin ends: at the first whitespace after CHUNK_SIZE
+	 * bytes, or failing that at a character boundary after twice that.
+	 */
+	std::size_t chunk_end(std::size_t begin) const
+	{
+		const char * data = file->data();
+		std::size_t size = file->size();
+		std::size_t end = std::min(begin + CHUNK_SIZE, size);
+		std::size_t limit = std::min(begin + 2 * CHUNK_SIZE, size);
+		while (end < limit && !std::isspace(static_cast<unsigned char>(data[end])))
+		{
+			++end;
+		}
+		while (end == limit && end < size && (static_cast<unsigned char>(data[end]) & 0xC0) == 0x80)
+		{
+			--end;
+		}
+		return end;
+	}
+
+	void submit_chunks()
+	{
+		while (in_flight.size() < window && next_begin < file->size())
+		{
+			chunk & c = in_flight.emplace_back();
+			c.begin = next_begin;
+			c.end = chunk_end(next_begin);
+			next_begin = c.end;
+			file->advise(c.begin, c.end - c.begin, mapped_file::advice::will_need);
+
+			group.run([this, &c]
+			{
+				if (!cancelled.load())
+				{
+					c.segmented = check_words(speller, std::string_view(file->data() + c.begin, c.end - c.begin), suggest, true, c.check);
+				}
+				std::lock_guard<std::mutex> lock(mtx);
+				c.done = true;
+				cv.notify_all();
+			});
+		}
+	}
+
+	/**
+	 * Waits for the front chunk, running queued chunks meanwhile like task_group::wait().
+	 */
+	void wait_for_front()
+	{
+		chunk & c = in_flight.front();
+		thread_pool & pool = thread_pool::instance();
+		while (true)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				if (c.done)
+				{
+					return;
+				}
+			}
+			if (!pool.run_pending_task(group))
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				cv.wait(lock, [&c] { return c.done; });
+				return;
+			}
+		}
+	}
+};
+
+typedef struct
+{
+	PyObject_HEAD
+	Speller * speller; // kept alive for the chunk jobs
+	file_check * check;
+	stats_timer * timer; // until the iterator is exhausted or dropped
+} FileCheck;
+
+static void FileCheck_dealloc(FileCheck * self)
+{
+	delete self->timer;
+	if (self->check)
+	{
+		self->check->cancelled = true;
+		Py_BEGIN_ALLOW_THREADS
+		self->check->group.wait();
+		Py_END_ALLOW_THREADS
+		delete self->check;
+	}
+	Py_XDECREF(self->speller);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject * FileCheck_iternext(FileCheck * self)
+{
+	// An empty file
+	if (self->check == nullptr)
+	{
+		delete self->timer;
+		self->timer = nullptr;
+		return nullptr;
+	}
+
+	file_check & check = *self->check;
+	while (true)
+	{
+		check.submit_chunks();
+		if (check.in_flight.empty())
+		{
+			delete self->timer;
+			self->timer = nullptr;
+			return nullptr;
+		}
+
+		file_check::chunk & c = check.in_flight.front();
+		Py_BEGIN_ALLOW_THREADS
+		check.wait_for_front();
+		Py_END_ALLOW_THREADS
+
+		if (!c.segmented)
+		{
+			PyErr_Format(PyExc_ValueError, "The text at byte %zu could not be split into words", c.begin);
+			return nullptr;
+		}
+
+		while (check.position < c.check.tokens.size())
+		{
+			const text_check::token & t = c.check.tokens[check.position++];
+			if (!c.check.correct[t.word])
+			{
+				return misspelling_tuple(self->speller, c.check, t, c.begin, check.suggest);
+			}
+		}
+
+		// Done with this part of the file, which keeps the memory used bounded
+		check.file->advise(c.begin, c.end - c.begin, mapped_file::advice::dont_need);
+		check.in_flight.pop_front();
+		check.position = 0;
+	}
+}
+
+static PyTypeObject FileCheckType = {
+	PyVarObject_HEAD_INIT(nullptr, 0)
+	.tp_name = "sibel.FileCheck",
+	.tp_basicsize = sizeof(FileCheck),
+	.tp_itemsize = 0,
+	.tp_dealloc = (destructor)FileCheck_dealloc,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_doc = "Iterator over the misspelt words of a file, as returned by Speller.check_file()",
+	.tp_iter = PyObject_SelfIter,
+	.tp_iternext = (iternextfunc)FileCheck_iternext,
+};
+
+static PyObject * Speller_check_file(Speller * self, PyObject * args, PyObject * kwds)
+{
+	std::unique_ptr<stats_timer> timer = time_method_until_done(self, timed_method::check_file);
+	static const char * kwlist[] = { "path", "suggest", nullptr };
+	PyObject * path_bytes;
+	int suggest = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|p", const_cast<char **>(kwlist), PyUnicode_FSConverter, &path_bytes, &suggest))
+	{
+		return nullptr;
+	}
+
+	std::filesystem::path path(PyBytes_AS_STRING(path_bytes));
+	std::unique_ptr<mapped_file> file;
+	std::error_code ec;
+	std::uintmax_t size;
+
+	Py_BEGIN_ALLOW_THREADS
+	size = std::filesystem::file_size(path, ec);
+	if (!ec && size > 0)
+	{
+		file.reset(mapped_file::open(path));
+	}
+	Py_END_ALLOW_THREADS
+
+	if (ec || (size > 0 && !file))
+	{
+		errno = ec ? ec.value() : errno;
+		PyErr_SetFromErrnoWithFilename(PyExc_OSError, PyBytes_AS_STRING(path_bytes));
+		Py_DECREF(path_bytes);
+		return nullptr;
+	}
+	Py_DECREF(path_bytes);
+
+	FileCheck * iterator = PyObject_New(FileCheck, &FileCheckType);
+	if (iterator == nullptr)
+	{
+		return nullptr;
+	}
+	Py_INCREF(self);
+	iterator->speller = self;
+	iterator->check = nullptr;
+	iterator->timer = timer.release();
+	if (file)
+	{
+		file->advise(0, file->size(), mapped_file::advice::sequential);
+		iterator->check = new file_check();
+		iterator->check->speller = self;
+		iterator->check->file = std::move(file);
+		iterator->check->suggest = suggest;
+		iterator->check->window = 2 * (thread_pool::instance().size() + 1);
+	}
+	return (PyObject *)iterator;
+}
+
+/**
+ * The finished job of an async method. result is called with the GIL held, and returns the
+ * result for the future or sets an exception.
+ */
+struct completion
+{
+	PyObject * future;
+	PyObject * speller;
+	std::function<PyObject *()> result;
+};
+
+/**
+ * Where the jobs of async methods post their results for one event loop. The loop watches
+ * the eventfd, which is written when a result arrives in an empty queue; the results posted
+ * by the time the loop gets round to it are then all handed out in one go.
+ */
+struct completion_channel
+{
+	int fd;
+	std::mutex mtx;
+	std::vector<completion> completed;
+	bool closed; // the loop is gone, and nothing hands out what is posted
+
+	explicit completion_channel(int fd) : fd(fd), closed(false) {}
+
+	~completion_channel()
+	{
+		close(fd);
+	}
+};
+
+/**
+ * The completion channel of one event loop. The jobs share the channel, which lasts until
+ * the last of them has posted to it.
+ */
+typedef struct
+{
+	PyObject_HEAD
+	std::shared_ptr<completion_channel> * channel;
+	PyObject * loop_ref; // weak, so that the loop can go away
+} CompletionQueue;
+
+/**
+ * The completion queue of each event loop still alive, by loop. Only used with the GIL held.
+ */
+static std::unordered_map<PyObject *, CompletionQueue *> completion_queues;
+
+static PyObject * get_running_loop;
+static PyObject * add_reader_name;
+static PyObject * create_future_name;
+static PyObject * is_closed_name;
+static PyObject * done_name;
+static PyObject * set_result_name;
+static PyObject * set_exception_name;
+
+/**
+ * Gives up the results posted to queue but not handed out, whose futures can no longer be
+ * awaited once its loop is closed or gone. Jobs still running give up theirs as they post.
+ */
+static void close_queue(CompletionQueue * queue)
+{
+	std::vector<completion> left;
+	{
+		std::lock_guard<std::mutex> lock((*queue->channel)->mtx);
+		(*queue->channel)->closed = true;
+		left.swap((*queue->channel)->completed);
+	}
+	for (completion & c : left)
+	{
+		c.result = nullptr;
+		Py_DECREF(c.future);
+		Py_DECREF(c.speller);
+	}
+}
+
+static void CompletionQueue_dealloc(CompletionQueue * self)
+{
+	if (self->channel)
+	{
+		close_queue(self);
+	}
+	delete self->channel;
+	Py_XDECREF(self->loop_ref);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/**
+ * Gives up the references of a completion no loop will hand out, unless the interpreter is
+ * shutting down. Called without the GIL.
+ */
+static void discard(completion & c)
+{
+#if PY_VERSION_HEX >= 0x030D0000
+	if (Py_IsFinalizing())
+#else
+	if (_Py_IsFinalizing())
+#endif
+	{
+		return;
+	}
+	PyGILState_STATE gil = PyGILState_Ensure();
+	c.result = nullptr;
+	Py_DECREF(c.future);
+	Py_DECREF(c.speller);
+	PyGILState_Release(gil);
+}
+
+/**
+ * Called without the GIL by the job that finished.
+ */
+static void post(completion_channel & channel, completion && c)
+{
+	bool closed;
+	bool wake = false;
+	{
+		std::lock_guard<std::mutex> lock(channel.mtx);
+		closed = channel.closed;
+		if (!closed)
+		{
+			wake = channel.completed.empty();
+			channel.completed.push_back(std::move(c));
+		}
+	}
+	if (closed)
+	{
+		discard(c);
+	}
+	if (wake)
+	{
+		std::uint64_t one = 1;
+		while (write(channel.fd, &one, sizeof one) < 0 && errno == EINTR)
+		{
+		}
+	}
+}
+
+/**
+ * Sets the result of a future, unless it has been cancelled in the meantime.
+ */
+static void deliver(PyObject * future, const std::function<PyObject *()> & result)
+{
+	PyObject * done = PyObject_CallMethodNoArgs(future, done_name);
+	if (done == nullptr || PyObject_IsTrue(done))
+	{
+		Py_XDECREF(done);
+		PyErr_Clear();
+		return;
+	}
+	Py_DECREF(done);
+
+	PyObject * value = result();
+	PyObject * status;
+	if (value)
+	{
+		status = PyObject_CallMethodOneArg(future, set_result_name, value);
+		Py_DECREF(value);
+	}
+	else
+	{
+		PyObject * type;
+		PyObject * exception;
+		PyObject * traceback;
+		PyErr_Fetch(&type, &exception, &traceback);
+		PyErr_NormalizeException(&type, &exception, &traceback);
+		if (traceback)
+		{
+			PyException_SetTraceback(exception, traceback);
+		}
+		status = PyObject_CallMethodOneArg(future, set_exception_name, exception);
+		Py_XDECREF(type);
+		Py_XDECREF(exception);
+		Py_XDECREF(traceback);
+	}
+	if (status == nullptr)
+	{
+		PyErr_WriteUnraisable(future);
+	}
+	Py_XDECREF(status);
+}
+
+/**
+ * The reader callback of the eventfd: hands out every result posted so far.
+ */
+static PyObject * CompletionQueue_drain(CompletionQueue * self, PyObject * Py_UNUSED(ignored))
+{
+	completion_channel & channel = **self->channel;
+
+	// Reset first, so that anything posted after the swap below writes again
+	std::uint64_t n;
+	while (read(channel.fd, &n, sizeof n) < 0 && errno == EINTR)
+	{
+	}
+
+	std::vector<completion> ready;
+	{
+		std::lock_guard<std::mutex> lock(channel.mtx);
+		ready.swap(channel.completed);
+	}
+	for (completion & c : ready)
+	{
+		deliver(c.future, c.result);
+		// The result may hold strings of the speller, so it goes first
+		c.result = nullptr;
+		Py_DECREF(c.future);
+		Py_DECREF(c.speller);
+	}
+	Py_RETURN_NONE;
+}
+
+static PyMethodDef CompletionQueue_methods[] = {
+	{ "_drain", (PyCFunction)CompletionQueue_drain, METH_NOARGS, "Hand out the results posted so far" },
+	{ nullptr, nullptr, 0, nullptr }
+};
+
+static PyTypeObject CompletionQueueType = {
+	PyVarObject_HEAD_INIT(nullptr, 0)
+	.tp_name = "sibel.CompletionQueue",
+	.tp_basicsize = sizeof(CompletionQueue),
+	.tp_itemsize = 0,
+	.tp_dealloc = (destructor)CompletionQueue_dealloc,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_doc = "The results of the async methods of all spellers for one event loop",
+	.tp_methods = CompletionQueue_methods,
+};
+
+/**
+ * The callback of the weak reference to a loop: forgets its queue.
+ */
+static PyObject * forget_loop(PyObject * Py_UNUSED(module), PyObject * loop_ref)
+{
+	for (auto it = completion_queues.begin(); it != completion_queues.end(); ++it)
+	{
+		if (it->second->loop_ref == loop_ref)
+		{
+			CompletionQueue * queue = it->second;
+			completion_queues.erase(it);
+			Py_DECREF(queue);
+			break;
+		}
+	}
+	Py_RETURN_NONE;
+}
+
+static PyMethodDef forget_loop_def = { "_forget_loop", forget_loop, METH_O, nullptr };
+
+/**
+ * The completion queue of loop, made and registered with the loop on first use.
+ * Returns a borrowed reference.
+ */
+static CompletionQueue * completion_queue(PyObject * loop)
+{
+	auto it = completion_queues.find(loop);
+	if (it != completion_queues.end())
+	{
+		return it->second;
+	}
+
+	// The futures of a loop closed before handing out every result keep it alive, so its
+	// queue is closed when the next loop comes along. Freeing a loop forgets its queue, hence
+	// the references held meanwhile
+	std::vector<CompletionQueue *> closed;
+	for (auto & [other, queue] : completion_queues)
+	{
+		PyObject * is_closed = PyObject_CallMethodNoArgs(other, is_closed_name);
+		if (is_closed && PyObject_IsTrue(is_closed))
+		{
+			Py_INCREF(queue);
+			closed.push_back(queue);
+		}
+		Py_XDECREF(is_closed);
+		PyErr_Clear();
+	}
+	for (CompletionQueue * queue : closed)
+	{
+		close_queue(queue);
+		Py_DECREF(queue);
+	}
+
+	CompletionQueue * queue = PyObject_New(CompletionQueue, &CompletionQueueType);
+	if (queue == nullptr)
+	{
+		return nullptr;
+	}
+	queue->channel = nullptr;
+	queue->loop_ref = nullptr;
+	int fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (fd < 0)
+	{
+		PyErr_SetFromErrno(PyExc_OSError);
+		Py_DECREF(queue);
+		return nullptr;
+	}
+	queue->channel = new std::shared_ptr<completion_channel>(std::make_shared<completion_channel>(fd));
+
+	PyObject * callback = PyCFunction_New(&forget_loop_def, nullptr);
+	queue->loop_ref = callback ? PyWeakref_NewRef(loop, callback) : nullptr;
+	Py_XDECREF(callback);
+	PyObject * drain = queue->loop_ref ? PyObject_GetAttrString((PyObject *)queue, "_drain") : nullptr;
+	PyObject * fd_object = drain ? PyLong_FromLong(fd) : nullptr;
+	PyObject * status = fd_object ? PyObject_CallMethodObjArgs(loop, add_reader_name, fd_object, drain, nullptr) : nullptr;
+	Py_XDECREF(fd_object);
+	Py_XDECREF(drain);
+	if (status == nullptr)
+	{
+		Py_DECREF(queue);
+		return nullptr;
+	}
+	Py_DECREF(status);
+
+	completion_queues.emplace(loop, queue);
+	return queue;
+}
+
+/**
+ * Runs work on the thread pool and returns a future of the running event loop, which gets
+ * the result of the function work returns. work runs without the GIL.
+ */
+static PyObject * run_async(Speller * self, timed_method method, std::function<std::function<PyObject *()>()> && work)
+{
+	std::shared_ptr<stats_timer> timer = time_method_until_done(self, method);
+
+	// asyncio is only imported by the first async call
+	if (get_running_loop == nullptr)
+	{
+		PyObject * asyncio = PyImport_ImportModule("asyncio");
+		get_running_loop = asyncio ? PyObject_GetAttrString(asyncio, "get_running_loop") : nullptr;
+		Py_XDECREF(asyncio);
+		if (get_running_loop == nullptr)
+		{
+			return nullptr;
+		}
+	}
+
+	PyObject * loop = PyObject_CallNoArgs(get_running_loop);
+	if (loop == nullptr)
+	{
+		return nullptr;
+	}
+	CompletionQueue * queue = completion_queue(loop);
+	PyObject * future = queue ? PyObject_CallMethodNoArgs(loop, create_future_name) : nullptr;
+	Py_DECREF(loop);
+	if (future == nullptr)
+	{
+		return nullptr;
+	}
+
+	auto guarded = [work = std::move(work)]() -> std::function<PyObject *()>
+	{
+		try
+		{
+			return work();
+		}
+		catch (const std::exception & e)
+		{
+			return [message = std::string(e.what())]() -> PyObject *
+			{
+				PyErr_SetString(PyExc_RuntimeError, message.c_str());
+				return nullptr;
+			};
+		}
+	};
+
+	// Without pool threads nothing would run the job, so the future is done right away
+	if (thread_pool::instance().size() == 0)
+	{
+		std::function<PyObject *()> result;
+		BEGIN_WITHOUT_GIL(self)
+		result = guarded();
+		END_WITHOUT_GIL
+		deliver(future, result);
+		return future;
+	}
+
+	// Both references are handed on to the completion, and given up by the loop
+	Py_INCREF(future);
+	Py_INCREF(self);
+	thread_pool::instance().submit([self, channel = *queue->channel, future, guarded = std::move(guarded), timer]() mutable
+	{
+		std::function<PyObject *()> result = guarded();
+		timer.reset();
+		post(*channel, { future, (PyObject *)self, std::move(result) });
+	});
+	return future;
+}
+
+static PyObject * Speller_aspell(Speller * self, PyObject * const * args, Py_ssize_t nargs)
+{
+	std::string_view word_view;
+	if (!word_argument("aspell", args, nargs, word_view))
+	{
+		return nullptr;
+	}
+
+	return run_async(self, timed_method::aspell, [self, word = std::string(word_view)]() -> std::function<PyObject *()>
+	{
+		bool ok = cached(self->caches->spell, word, [&]
+		{
+			return spelt_correctly(self, word);
+		});
+		return [ok]
+		{
+			return PyBool_FromLong(ok);
+		};
+	});
+}
+
+static PyObject * Speller_asuggest(Speller * self, PyObject * const * args, Py_ssize_t nargs, PyObject * kwnames)
+{
+	std::string_view word_view;
+	call_limits limits;
+	bool limited;
+	suggestion_engine engine;
+	if (!limited_word_arguments("asuggest", args, nargs, kwnames, word_view, limits, limited, &engine) || !engine_available(self, engine))
+	{
+		return nullptr;
+	}
+
+	return run_async(self, timed_method::asuggest, [self, word = std::string(word_view), limits, limited, engine]() -> std::function<PyObject *()>
+	{
+		bool partial = false;
+		std::vector<std::string> suggestions = suggest_with(self, word, limits, engine, partial);
+		return [self, suggestions = std::move(suggestions), limits, limited, partial]
+		{
+			return limited_result(self, suggestions, limits, limited, partial);
+		};
+	});
+}
+
+/**
+ * The async version of a list-valued backend method.
+ */
+static PyObject * apply_async(Speller * self, PyObject * const * args, Py_ssize_t nargs, std::vector<std::string> (spelling_backend::*method)(const std::string &), clock_cache<std::vector<std::string>> & cache, timed_method timed)
+{
+	std::string_view word_view;
+	if (!word_argument(TIMED_METHODS[static_cast<std::size_t>(timed)], args, nargs, word_view))
+	{
+		return nullptr;
+	}
+
+	return run_async(self, timed, [self, word = std::string(word_view), method, &cache]() -> std::function<PyObject *()>
+	{
+		std::vector<std::string> results = cached(cache, word, [&]
+		{
+			return ((*self->backends->acquire()).*method)(word);
+		});
+		return [self, results = std::move(results)]
+		{
+			return string_list(results, *self->strings);
+		};
+	});
+}
+
+static PyObject * Speller_aanalyse(Speller * self, PyObject * const * args, Py_ssize_t nargs)
+{
+	return apply_async(self, args, nargs, &spelling_backend::analyse, self->caches->analyse, timed_method::aanalyse);
+}
+
+static PyObject * Speller_astem(Speller * self, PyObject * const * args, Py_ssize_t nargs)
+{
+	return apply_async(self, args, nargs, &spelling_backend::stem, self->caches->stem, timed_method::astem);
+}
+
+static PyObject * Speller_aorthographic_forms(Speller * self, PyObject * const * args, Py_ssize_t nargs, PyObject * kwnames)
+{
+	std::string_view word_view;
+	call_limits limits;
+	bool limited;
+	if (!limited_word_arguments("aorthographic_forms", args, nargs, kwnames, word_view, limits, limited))
+	{
+		return nullptr;
+	}
+
+	return run_async(self, timed_method::aorthographic_forms, [self, word = std::string(word_view), limits, limited]() -> std::function<PyObject *()>
+	{
+		bool partial = false;
+		std::vector<std::string> forms = orthographic_forms_within(self, word, limits, partial);
+		return [self, forms = std::move(forms), limits, limited, partial]
+		{
+			return limited_result(self, forms, limits, limited, partial);
+		};
+	});
+}
+
+static PyObject * Speller_acheck_text(Speller * self, PyObject * args, PyObject * kwds)
+{
+	static const char * kwlist[] = { "text", "suggest", nullptr };
+	const char * buf_text;
+	Py_ssize_t text_size;
+	int suggest = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "s#|p", const_cast<char **>(kwlist), &buf_text, &text_size, &suggest))
+	{
+		return nullptr;
+	}
+
+	return run_async(self, timed_method::acheck_text, [self, text = std::string(buf_text, text_size), suggest]() -> std::function<PyObject *()>
+	{
+		auto check = std::make_shared<text_check>();
+		bool segmented = check_words(self, text, suggest, false, *check);
+		return [self, check, segmented, suggest]
+		{
+			return misspellings(self, *check, segmented, suggest);
+		};
+	});
+}
+
+template <typename V>
+static PyObject * cache_info(clock_cache<V> & cache)
+{
+	return Py_BuildValue("{s:K,s:K,s:n,s:n}", "hits", (unsigned long long)cache.hits(), "misses", (unsigned long long)cache.misses(), "size", (Py_ssize_t)cache.size(), "capacity", (Py_ssize_t)cache.capacity());
+}
+
+static PyObject * Speller_cache_info(Speller * self, PyObject * Py_UNUSED(ignored))
+{
+	PyObject * infos[] = {
+		cache_info(self->caches->spell),
+		cache_info(self->caches->suggest),
+		cache_info(self->caches->analyse),
+		cache_info(self->caches->stem),
+		cache_info(self->caches->orthographic_forms)
+	};
+
+	PyObject * result = PyDict_New();
+	for (std::size_t i = 0; i < std::size(CACHED_METHODS); ++i)
+	{
+		if (result && (infos[i] == nullptr || PyDict_SetItemString(result, CACHED_METHODS[i], infos[i]) < 0))
+		{
+			Py_CLEAR(result);
+		}
+		Py_XDECREF(infos[i]);
+	}
+	return result;
+}
+
+/**
+ * {"calls": ..., "total_ns": ..., "latency_ns": {lower bound of bucket: calls}}, listing
+ * only the buckets that are not empty.
+ */
+static PyObject * method_stats_dict(const method_stats & stats)
+{
+	PyObject * histogram = PyDict_New();
+	for (std::size_t i = 0; histogram && i < method_stats::LATENCY_BUCKETS; ++i)
+	{
+		std::uint64_t n = stats.bucket(i);
+		if (n == 0)
+		{
+			continue;
+		}
+		PyObject * bound = PyLong_FromUnsignedLongLong(i == 0 ? 0 : 1ULL << i);
+		PyObject * value = PyLong_FromUnsignedLongLong(n);
+		if (bound == nullptr || value == nullptr || PyDict_SetItem(histogram, bound, value) < 0)
+		{
+			Py_CLEAR(histogram);
+		}
+		Py_XDECREF(bound);
+		Py_XDECREF(value);
+	}
+	if (histogram == nullptr)
+	{
+		return nullptr;
+	}
+	return Py_BuildValue("{s:K,s:K,s:N}", "calls", (unsigned long long)stats.calls(), "total_ns", (unsigned long long)stats.total_time_ns(), "latency_ns", histogram);
+}
+
+/**
+ * Sets key of dict to value, which may be nullptr after a failure, and steals value.
+ */
+static bool set_item(PyObject * dict, const char * key, PyObject * value)
+{
+	bool ok = value != nullptr && PyDict_SetItemString(dict, key, value) == 0;
+	Py_XDECREF(value);
+	return ok;
+}
+
+static PyObject * speller_stats_dict(const speller_stats & stats)
+{
+	PyObject * result = PyDict_New();
+	PyObject * methods = PyDict_New();
+	PyObject * paths = PyDict_New();
+	bool ok = result && methods && paths;
+
+	for (std::size_t i = 0; ok && i < std::size(TIMED_METHODS); ++i)
+	{
+		ok = set_item(methods, TIMED_METHODS[i], method_stats_dict(stats.methods[i]));
+	}
+	for (std::size_t i = 0; ok && i < std::size(ORTHOGRAPHIC_PATHS); ++i)
+	{
+		ok = set_item(paths, ORTHOGRAPHIC_PATHS[i], PyLong_FromUnsignedLongLong(stats.paths[i].load(std::memory_order_relaxed)));
+	}
+	ok = ok && PyDict_SetItemString(result, "methods", methods) == 0
+		&& set_item(result, "without_gil", method_stats_dict(stats.without_gil))
+		&& PyDict_SetItemString(result, "orthographic_forms_paths", paths) == 0
+		&& set_item(result, "candidates", Py_BuildValue("{s:K,s:K,s:K}",
+			"generated", (unsigned long long)stats.candidates_generated.load(std::memory_order_relaxed),
+			"pruned", (unsigned long long)stats.candidates_pruned.load(std::memory_order_relaxed),
+			"checked", (unsigned long long)stats.candidates_checked.load(std::memory_order_relaxed)))
+		&& set_item(result, "partial_results", PyLong_FromUnsignedLongLong(stats.partial_results.load(std::memory_order_relaxed)))
+		&& set_item(result, "word_set_hits", PyLong_FromUnsignedLongLong(stats.word_set_hits.load(std::memory_order_relaxed)));
+
+	Py_XDECREF(methods);
+	Py_XDECREF(paths);
+	if (!ok)
+	{
+		Py_XDECREF(result);
+		return nullptr;
+	}
+	return result;
+}
+
+static PyObject * Speller_stats(Speller * self, PyObject * Py_UNUSED(ignored))
+{
+	return speller_stats_dict(*self->stats);
+}
+
+static PyMethodDef Speller_methods[] = {
+	{ "spell", (PyCFunction)Speller_spell, METH_FASTCALL, "Check if a word is spelt correctly" },
+	{ "suggest", (PyCFunction)(void (*)(void))Speller_suggest, METH_FASTCALL | METH_KEYWORDS, "Get spelling suggestions for a word, optionally at most max_results of them within timeout_ms, or only the best top_k" },
+	{ "analyse", (PyCFunction)Speller_analyse, METH_FASTCALL, "Get morphological analysis of a word" },
+	{ "stem", (PyCFunction)Speller_stem, METH_FASTCALL, "Get stems of a word" },
+	{ "orthographic_forms", (PyCFunction)(void (*)(void))Speller_orthographic_forms, METH_FASTCALL | METH_KEYWORDS, "Get orthographic forms of a word in ASCII form, optionally at most max_results of them within timeout_ms, or only the best top_k" },
+	{ "spell_many", (PyCFunction)Speller_spell_many, METH_FASTCALL, "Check a batch of words, returning bytes with 1 for each word spelt correctly and 0 otherwise" },
+	{ "suggest_many", (PyCFunction)Speller_suggest_many, METH_FASTCALL, "Get spelling suggestions for a batch of words" },
+	{ "analyse_many", (PyCFunction)Speller_analyse_many, METH_FASTCALL, "Get morphological analyses of a batch of words" },
+	{ "stem_many", (PyCFunction)Speller_stem_many, METH_FASTCALL, "Get stems of a batch of words" },
+	{ "add", (PyCFunction)Speller_add, METH_FASTCALL, "Add a word to the runtime dictionary" },
+	{ "check_text", (PyCFunction)(void (*)(void))Speller_check_text, METH_VARARGS | METH_KEYWORDS, "Find the misspelt words of a text, with their offsets and optionally suggestions" },
+	{ "check_file", (PyCFunction)(void (*)(void))Speller_check_file, METH_VARARGS | METH_KEYWORDS, "Iterate over the misspelt words of a UTF-8 file, with their byte offsets and optionally suggestions" },
+	{ "aspell", (PyCFunction)Speller_aspell, METH_FASTCALL, "Awaitable version of spell(), run on the thread pool" },
+	{ "asuggest", (PyCFunction)(void (*)(void))Speller_asuggest, METH_FASTCALL | METH_KEYWORDS, "Awaitable version of suggest(), run on the thread pool" },
+	{ "aanalyse", (PyCFunction)Speller_aanalyse, METH_FASTCALL, "Awaitable version of analyse(), run on the thread pool" },
+	{ "astem", (PyCFunction)Speller_astem, METH_FASTCALL, "Awaitable version of stem(), run on the thread pool" },
+	{ "aorthographic_forms", (PyCFunction)(void (*)(void))Speller_aorthographic_forms, METH_FASTCALL | METH_KEYWORDS, "Awaitable version of orthographic_forms(), run on the thread pool" },
+	{ "acheck_text", (PyCFunction)(void (*)(void))Speller_acheck_text, METH_VARARGS | METH_KEYWORDS, "Awaitable version of check_text(), run on the thread pool" },
+	{ "cache_info", (PyCFunction)Speller_cache_info, METH_NOARGS, "Get the hits, misses, size and capacity of each result cache" },
+	{ "stats", (PyCFunction)Speller_stats, METH_NOARGS, "Get the call counts, latency histograms and candidate statistics of this speller" },
+	{ nullptr, nullptr, 0, nullptr }
+};
+
+static PyTypeObject SpellerType = {
+	PyVarObject_HEAD_INIT(nullptr, 0)
+	.tp_name = "sibel.Speller",
+	.tp_basicsize = sizeof(Speller),
+	.tp_itemsize = 0,
+	.tp_dealloc = (destructor)Speller_dealloc,
+	.tp_vectorcall_offset = 0,
+	.tp_getattr = nullptr,
+	.tp_setattr = nullptr,
+	.tp_as_async = nullptr,
+	.tp_repr = nullptr,
+	.tp_as_number = nullptr,
+	.tp_as_sequence = nullptr,
+	.tp_as_mapping = nullptr,
+	.tp_hash = nullptr,
+	.tp_call = nullptr,
+	.tp_str = nullptr,
+	.tp_getattro = nullptr,
+	.tp_setattro = nullptr,
+	.tp_as_buffer = nullptr,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_doc = "Python spellchecker with Hunspell as backend",
+	.tp_traverse = nullptr,
+	.tp_clear = nullptr,
+	.tp_richcompare = nullptr,
+	.tp_weaklistoffset = 0,
+	.tp_iter = nullptr,
+	.tp_iternext = nullptr,
+	.tp_methods = Speller_methods,
+	.tp_members = nullptr,
+	.tp_getset = nullptr,
+	.tp_base = nullptr,
+	.tp_dict = nullptr,
+	.tp_descr_get = nullptr,
+	.tp_descr_set = nullptr,
+	.tp_dictoffset = 0,
+	.tp_init = (initproc)Speller_init,
+	.tp_alloc = nullptr,
+	.tp_new = Speller_new,
+	.tp_free = nullptr,
+	.tp_is_gc = nullptr,
+	.tp_bases = nullptr,
+	.tp_mro = nullptr,
+	.tp_cache = nullptr,
+	.tp_subclasses = nullptr,
+	.tp_weaklist = nullptr,
+	.tp_del = nullptr,
+	.tp_version_tag = 0,
+	.tp_finalize = nullptr,
+	.tp_vectorcall = nullptr
+};
+
+/**
+ * Spellers for several languages, checked together. A word is correct if any of them
+ * accepts it.
+ */
 typedef struct
 {
 	PyObject_HEAD
-	Hunspell * hunspell;
-	const substitution_table * sub_table;
-} Speller;
+	PyObject * lang_codes; // tuple of str
+	PyObject * spellers; // tuple of Speller, in the same order
+} MultiSpeller;
 
-static PyObject * Speller_new(PyTypeObject * type, PyObject * args, PyObject * kwds)
+static PyMemberDef MultiSpeller_members[] = {
+	{ "lang_codes", T_OBJECT, offsetof(MultiSpeller, lang_codes), READONLY, "The language codes, in the order their dictionaries are tried" },
+	{ "spellers", T_OBJECT, offsetof(MultiSpeller, spellers), READONLY, "The Speller of each language" },
+	{ nullptr, 0, 0, 0, nullptr }
+};
+
+/**
+ * The keyword arguments of the Speller of one language. The files of a language's own
+ * can be given as a dict keyed by language code, and have to be when there are several
+ * languages; a language missing from the dict gets the default. Returns a new dict.
+ */
+static PyObject * language_kwds(PyObject * kwds, PyObject * lang_code, Py_ssize_t n_languages)
 {
-	Speller * self;
-	self = (Speller *)type->tp_alloc(type, 0);
-	if (self != nullptr)
+	static const char * per_language[] = { "substitution_table", "frequencies" };
+
+	PyObject * result = kwds ? PyDict_Copy(kwds) : PyDict_New();
+	for (const char * name : per_language)
 	{
-		self->hunspell = nullptr;
-		self->sub_table = nullptr;
+		// Still referenced by kwds when replaced below
+		PyObject * value = result ? PyDict_GetItemString(result, name) : nullptr;
+		if (value == nullptr || value == Py_None)
+		{
+			continue;
+		}
+		if (!PyDict_Check(value))
+		{
+			if (n_languages > 1)
+			{
+				PyErr_Format(PyExc_TypeError, "%s must be a dict keyed by language code when there are several languages", name);
+				Py_CLEAR(result);
+			}
+			continue;
+		}
+		PyObject * own = PyDict_GetItemWithError(value, lang_code);
+		if ((own == nullptr && PyErr_Occurred()) || PyDict_SetItemString(result, name, own ? own : Py_None) < 0)
+		{
+			Py_CLEAR(result);
+		}
 	}
-	return (PyObject *)self;
+	return result;
 }
 
-static int Speller_init(Speller * self, PyObject * args, PyObject * kwds)
+static int MultiSpeller_init(MultiSpeller * self, PyObject * args, PyObject * kwds)
 {
-	const char * buf_base_path;
-	const char * buf_lang_code;
-
-	if (!PyArg_ParseTuple(args, "ss", &buf_base_path, &buf_lang_code))
+	PyObject * base_path;
+	PyObject * lang_codes_arg;
+	if (!PyArg_UnpackTuple(args, "MultiSpeller", 2, 2, &base_path, &lang_codes_arg))
 	{
 		return -1;
 	}
-
-	std::string lang_code(buf_lang_code);
-	std::string lang_code_no_country = lang_code.substr(0, 2);
-	if (SUBSTITUTION_TABLES.find(lang_code_no_country) != SUBSTITUTION_TABLES.end())
+	if (PyUnicode_Check(lang_codes_arg))
 	{
-		self->sub_table = &(SUBSTITUTION_TABLES.at(lang_code_no_country));
+		PyErr_SetString(PyExc_TypeError, "lang_codes must be an iterable of str, not a str");
+		return -1;
 	}
-	else
+	PyObject * lang_codes = PySequence_Tuple(lang_codes_arg);
+	if (lang_codes == nullptr)
 	{
-		self->sub_table = nullptr;
+		return -1;
 	}
-
-	std::filesystem::path base_path = std::filesystem::u8path(buf_base_path);
-	std::filesystem::path aff_path = base_path / (lang_code + ".aff");
-	std::filesystem::path dic_path = base_path / (lang_code + ".dic");
-
-	if (!std::filesystem::exists(aff_path))
+	Py_ssize_t n = PyTuple_GET_SIZE(lang_codes);
+	if (n == 0)
 	{
-		PyErr_SetString(DictionaryLoadingError, "The .aff file does not exist");
+		PyErr_SetString(PyExc_ValueError, "A MultiSpeller needs at least one language");
+		Py_DECREF(lang_codes);
 		return -1;
 	}
-	if (!std::filesystem::exists(dic_path))
+
+	// The other arguments are the same for every language
+	PyObject * spellers = PyTuple_New(n);
+	for (Py_ssize_t i = 0; spellers && i < n; ++i)
 	{
-		PyErr_SetString(DictionaryLoadingError, "The .dic file does not exist");
+		PyObject * speller_args = PyTuple_Pack(2, base_path, PyTuple_GET_ITEM(lang_codes, i));
+		PyObject * speller_kwds = speller_args ? language_kwds(kwds, PyTuple_GET_ITEM(lang_codes, i), n) : nullptr;
+		PyObject * speller = speller_kwds ? PyObject_Call((PyObject *)&SpellerType, speller_args, speller_kwds) : nullptr;
+		Py_XDECREF(speller_args);
+		Py_XDECREF(speller_kwds);
+		if (speller == nullptr)
+		{
+			Py_CLEAR(spellers);
+			break;
+		}
+		PyTuple_SET_ITEM(spellers, i, speller);
+	}
+	if (spellers == nullptr)
+	{
+		Py_DECREF(lang_codes);
 		return -1;
 	}
 
-	self->hunspell = new Hunspell(aff_path.c_str(), dic_path.c_str());
-
+	Py_XSETREF(self->lang_codes, lang_codes);
+	Py_XSETREF(self->spellers, spellers);
 	return 0;
 }
 
-static void Speller_dealloc(Speller * self)
+static void MultiSpeller_dealloc(MultiSpeller * self)
 {
-	delete self->hunspell;
+	Py_XDECREF(self->lang_codes);
+	Py_XDECREF(self->spellers);
 	Py_TYPE(self)->tp_free((PyObject *)self);
 }
 
-static PyObject * Speller_spell(Speller * self, PyObject * args)
+static std::vector<Speller *> members(MultiSpeller * self)
 {
-	const char * buf_word;
-	if (!PyArg_ParseTuple(args, "s", &buf_word))
+	std::vector<Speller *> spellers;
+	if (self->spellers == nullptr)
 	{
-		return nullptr;
+		PyErr_SetString(PyExc_RuntimeError, "The MultiSpeller has not been initialised");
+		return spellers;
 	}
+	for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(self->spellers); ++i)
+	{
+		spellers.push_back((Speller *)PyTuple_GET_ITEM(self->spellers, i));
+	}
+	return spellers;
+}
 
-	const std::string word(buf_word);
-	bool ok;
-	
-	Py_BEGIN_ALLOW_THREADS
-	ok = self->hunspell->spell(word);
-	Py_END_ALLOW_THREADS
-
-	if (ok)
+/**
+ * Calls find for every speller, in parallel on the thread pool, and merges the results in
+ * the order of the spellers.
+ */
+static std::vector<std::string> merge_over(const std::vector<Speller *> & spellers, const std::function<std::vector<std::string>(Speller *)> & find)
+{
+	std::vector<std::vector<std::string>> results(spellers.size());
+	if (spellers.size() == 1)
 	{
-		Py_RETURN_TRUE;
+		results[0] = find(spellers[0]);
 	}
 	else
 	{
-		Py_RETURN_FALSE;
+		task_group group;
+		for (std::size_t i = 0; i < spellers.size(); ++i)
+		{
+			group.run([&spellers, &find, &results, i]
+			{
+				results[i] = find(spellers[i]);
+			});
+		}
+		group.wait();
 	}
+
+	std::vector<std::string> merged;
+	for (std::vector<std::string> & result : results)
+	{
+		merge_unique(merged, std::move(result));
+	}
+	return merged;
 }
 
-static PyObject * Speller_suggest(Speller * self, PyObject * args)
+static PyObject * MultiSpeller_spell(MultiSpeller * self, PyObject * const * args, Py_ssize_t nargs)
 {
-	const char * buf_word;
-	if (!PyArg_ParseTuple(args, "s", &buf_word))
+	std::string_view word_view;
+	if (!word_argument("spell", args, nargs, word_view))
+	{
+		return nullptr;
+	}
+	std::vector<Speller *> spellers = members(self);
+	if (spellers.empty())
 	{
 		return nullptr;
 	}
 
-	const std::string word(buf_word);
-	std::vector<std::string> suggestions;
+	const std::string word(word_view);
+	std::vector<char> accepted(spellers.size());
+	auto check = [&spellers, &word, &accepted](std::size_t i)
+	{
+		stats_timer timer = time_method(spellers[i], timed_method::spell);
+		accepted[i] = cached(spellers[i]->caches->spell, word, [&]
+		{
+			return spelt_correctly(spellers[i], word);
+		});
+	};
 
+	// In parallel on the thread pool, as merge_over() does
 	Py_BEGIN_ALLOW_THREADS
-	suggestions = self->hunspell->suggest(word);
+	if (spellers.size() == 1)
+	{
+		check(0);
+	}
+	else
+	{
+		task_group group;
+		for (std::size_t i = 0; i < spellers.size(); ++i)
+		{
+			group.run([&check, i]
+			{
+				check(i);
+			});
+		}
+		group.wait();
+	}
 	Py_END_ALLOW_THREADS
 
-	PyObject * suggestions_list = PyList_New(suggestions.size());
-	for (std::size_t i = 0; i < suggestions.size(); ++i)
+	std::size_t n_accepted = std::count(accepted.cbegin(), accepted.cend(), 1);
+	PyObject * result = PyTuple_New(n_accepted);
+	for (std::size_t i = 0, j = 0; result && i < spellers.size(); ++i)
 	{
-		PyList_SetItem(suggestions_list, i, PyUnicode_FromString(suggestions[i].c_str()));
+		if (accepted[i])
+		{
+			PyObject * code = PyTuple_GET_ITEM(self->lang_codes, i);
+			Py_INCREF(code);
+			PyTuple_SET_ITEM(result, j++, code);
+		}
 	}
-
-	return suggestions_list;
+	return result;
 }
 
-static PyObject * Speller_analyse(Speller * self, PyObject * args)
+static PyObject * MultiSpeller_suggest(MultiSpeller * self, PyObject * const * args, Py_ssize_t nargs)
 {
-	const char * buf_word;
-	if (!PyArg_ParseTuple(args, "s", &buf_word))
+	std::string_view word_view;
+	if (!word_argument("suggest", args, nargs, word_view))
+	{
+		return nullptr;
+	}
+	std::vector<Speller *> spellers = members(self);
+	if (spellers.empty())
 	{
 		return nullptr;
 	}
 
-	const std::string word(buf_word);
-	std::vector<std::string> analyses;
+	const std::string word(word_view);
+	std::vector<std::string> suggestions;
 
 	Py_BEGIN_ALLOW_THREADS
-	analyses = self->hunspell->analyze(word);
+	suggestions = merge_over(spellers, [&word](Speller * speller)
+	{
+		stats_timer timer = time_method(speller, timed_method::suggest);
+		bool partial = false;
+		return suggest_within(speller, word, call_limits(), partial);
+	});
 	Py_END_ALLOW_THREADS
 
-	PyObject * analyses_list = PyList_New(analyses.size());
-	for (std::size_t i = 0; i < analyses.size(); ++i)
+	return string_list(suggestions, *spellers[0]->strings);
+}
+
+static PyObject * MultiSpeller_orthographic_forms(MultiSpeller * self, PyObject * const * args, Py_ssize_t nargs)
+{
+	std::string_view word_view;
+	if (!word_argument("orthographic_forms", args, nargs, word_view))
+	{
+		return nullptr;
+	}
+	std::vector<Speller *> spellers = members(self);
+	if (spellers.empty())
 	{
-		PyList_SetItem(analyses_list, i, PyUnicode_FromString(analyses[i].c_str()));
+		return nullptr;
 	}
 
-	return analyses_list;
+	const std::string word(word_view);
+	std::vector<std::string> forms;
+
+	Py_BEGIN_ALLOW_THREADS
+	forms = merge_over(spellers, [&word](Speller * speller)
+	{
+		stats_timer timer = time_method(speller, timed_method::orthographic_forms);
+		bool partial = false;
+		return orthographic_forms_within(speller, word, call_limits(), partial);
+	});
+	Py_END_ALLOW_THREADS
+
+	return string_list(forms, *spellers[0]->strings);
 }
 
-static PyObject * Speller_stem(Speller * self, PyObject * args)
+static PyObject * MultiSpeller_check_text(MultiSpeller * self, PyObject * args, PyObject * kwds)
 {
-	const char * buf_word;
-	if (!PyArg_ParseTuple(args, "s", &buf_word))
+	static const char * kwlist[] = { "text", "suggest", nullptr };
+	const char * buf_text;
+	Py_ssize_t text_size;
+	int suggest = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "s#|p", const_cast<char **>(kwlist), &buf_text, &text_size, &suggest))
+	{
+		return nullptr;
+	}
+	std::vector<Speller *> spellers = members(self);
+	if (spellers.empty())
 	{
 		return nullptr;
 	}
 
-	const std::string word(buf_word);
-	std::vector<std::string> stems;
+	// Every speller is asked about every word, so the call counts as one of each
+	std::deque<stats_timer> timers;
+	for (Speller * speller : spellers)
+	{
+		std::size_t i = static_cast<std::size_t>(timed_method::check_text);
+		timers.emplace_back(speller->stats->methods[i], all_spellers_stats.methods[i]);
+	}
+
+	text_check check;
+	bool segmented;
 
 	Py_BEGIN_ALLOW_THREADS
-	stems = self->hunspell->stem(word);
+	segmented = check_words(spellers, std::string_view(buf_text, text_size), suggest, false, check);
 	Py_END_ALLOW_THREADS
 
-	PyObject * stems_list = PyList_New(stems.size());
-	for (std::size_t i = 0; i < stems.size(); ++i)
-	{
-		PyList_SetItem(stems_list, i, PyUnicode_FromString(stems[i].c_str()));
-	}
+	return misspellings(spellers[0], check, segmented, suggest);
+}
+
+static PyMethodDef MultiSpeller_methods[] = {
+	{ "spell", (PyCFunction)MultiSpeller_spell, METH_FASTCALL, "Get the language codes of the dictionaries that accept a word" },
+	{ "suggest", (PyCFunction)MultiSpeller_suggest, METH_FASTCALL, "Get the spelling suggestions of every language for a word, merged in order" },
+	{ "orthographic_forms", (PyCFunction)MultiSpeller_orthographic_forms, METH_FASTCALL, "Get the orthographic forms of a word in every language, merged in order" },
+	{ "check_text", (PyCFunction)(void (*)(void))MultiSpeller_check_text, METH_VARARGS | METH_KEYWORDS, "Find the words of a text that no language accepts, with their offsets and optionally suggestions" },
+	{ nullptr, nullptr, 0, nullptr }
+};
+
+static PyTypeObject MultiSpellerType = {
+	PyVarObject_HEAD_INIT(nullptr, 0)
+	.tp_name = "sibel.MultiSpeller",
+	.tp_basicsize = sizeof(MultiSpeller),
+	.tp_itemsize = 0,
+	.tp_dealloc = (destructor)MultiSpeller_dealloc,
+	.tp_flags = Py_TPFLAGS_DEFAULT,
+	.tp_doc = "Spellchecker for text in several languages",
+	.tp_methods = MultiSpeller_methods,
+	.tp_members = MultiSpeller_members,
+	.tp_init = (initproc)MultiSpeller_init,
+	.tp_new = PyType_GenericNew,
+};
+
+static PyObject * sibel_get_thread_pool_size(PyObject * self, PyObject * args)
+{
+	std::size_t size;
+
+	Py_BEGIN_ALLOW_THREADS
+	size = thread_pool::instance().size();
+	Py_END_ALLOW_THREADS
 
-	return stems_list;
+	return PyLong_FromSize_t(size);
 }
 
-static PyObject * Speller_orthographic_forms(Speller * self, PyObject * args)
+static PyObject * sibel_set_thread_pool_size(PyObject * self, PyObject * args)
 {
-	const char * buf_word;
-	if (!PyArg_ParseTuple(args, "s", &buf_word))
+	Py_ssize_t size;
+	if (!PyArg_ParseTuple(args, "n", &size))
 	{
 		return nullptr;
 	}
-
-	const std::string word(buf_word);
-	std::vector<std::string> forms;
+	if (size < 0)
+	{
+		PyErr_SetString(PyExc_ValueError, "The thread pool size cannot be negative");
+		return nullptr;
+	}
 
 	Py_BEGIN_ALLOW_THREADS
-	std::vector<std::thread> threads;
-	std::mutex mtx;
+	thread_pool::instance().resize(size);
+	Py_END_ALLOW_THREADS
 
-	if (substitution_table::is_substitutable(word))
-	{
-		if (self->sub_table && word.size() <= substitution_table::SUBSTITUTION_MAX_LENGTH)
-		{
-			for (const std::string & possible_form : self->sub_table->substitute(word))
-			{
-				threads.push_back(std::thread([&](const std::string & form)
-				{
-					if (self->hunspell->spell(form))
-					{
-						std::lock_guard<std::mutex> lock(mtx);
-						forms.push_back(form);
-					}
-				}, possible_form));
-			}
+	Py_RETURN_NONE;
+}
 
-			for (std::thread & t : threads)
-			{
-				t.join();
-			}
-		}
-		else
-		{
-			std::string word_simplified(simplify(word));
-			
-			for (const std::string & suggestion : self->hunspell->suggest(word))
-			{
-				threads.push_back(std::thread([&](const std::string & s)
-				{
-					if (is_without_banned_chars(s) && simplify(s) == word_simplified)
-					{
-						std::lock_guard<std::mutex> lock(mtx);
-						forms.push_back(s);
-					}
-				}, suggestion));
-			}
+static PyObject * sibel_after_fork_in_child(PyObject * self, PyObject * Py_UNUSED(ignored))
+{
+	Py_BEGIN_ALLOW_THREADS
+	thread_pool::replace_after_fork();
+	Py_END_ALLOW_THREADS
 
-			for (std::thread & t : threads)
-			{
-				t.join();
-			}
-		}
-	}
-	else
+	Py_RETURN_NONE;
+}
+
+static PyObject * sibel_stats(PyObject * self, PyObject * Py_UNUSED(ignored))
+{
+	PyObject * result = speller_stats_dict(all_spellers_stats);
+	if (result == nullptr)
 	{
-		if (self->hunspell->spell(word))
-		{
-			forms.push_back(word);
-		}
+		return nullptr;
 	}
+
+	thread_pool & pool = thread_pool::instance();
+	std::size_t size;
+
+	Py_BEGIN_ALLOW_THREADS
+	size = pool.size();
 	Py_END_ALLOW_THREADS
 
-	PyObject * forms_list = PyList_New(forms.size());
-	for (std::size_t i = 0; i < forms.size(); ++i)
+	if (!set_item(result, "enabled", PyBool_FromLong(stats_enabled.load()))
+		|| !set_item(result, "thread_pool", Py_BuildValue("{s:n,s:K,s:K,s:K}",
+			"threads", (Py_ssize_t)size,
+			"threads_started", (unsigned long long)pool.threads_started(),
+			"tasks_submitted", (unsigned long long)pool.tasks_submitted(),
+			"tasks_stolen", (unsigned long long)pool.tasks_stolen())))
 	{
-		PyList_SetItem(forms_list, i, PyUnicode_FromString(forms[i].c_str()));
+		Py_DECREF(result);
+		return nullptr;
 	}
+	return result;
+}
 
-	return forms_list;
+static PyObject * sibel_get_stats_enabled(PyObject * self, PyObject * Py_UNUSED(ignored))
+{
+	return PyBool_FromLong(stats_enabled.load());
 }
 
-static PyMethodDef Speller_methods[] = {
-	{ "spell", (PyCFunction)Speller_spell, METH_VARARGS, "Check if a word is spelt correctly" },
-	{ "suggest", (PyCFunction)Speller_suggest, METH_VARARGS, "Get spelling suggestions for a word" },
-	{ "analyse", (PyCFunction)Speller_analyse, METH_VARARGS, "Get morphological analysis of a word" },
-	{ "stem", (PyCFunction)Speller_stem, METH_VARARGS, "Get stems of a word" },
-	{ "orthographic_forms", (PyCFunction)Speller_orthographic_forms, METH_VARARGS, "Get orthographic forms of a word in ASCII form" },
-	{ nullptr, nullptr, 0, nullptr }
-};
+static PyObject * sibel_set_stats_enabled(PyObject * self, PyObject * args)
+{
+	int enabled;
+	if (!PyArg_ParseTuple(args, "p", &enabled))
+	{
+		return nullptr;
+	}
+	stats_enabled.store(enabled);
+	Py_RETURN_NONE;
+}
 
-static PyTypeObject SpellerType = {
-	PyVarObject_HEAD_INIT(nullptr, 0)
-	.tp_name = "sibel.Speller",
-	.tp_basicsize = sizeof(Speller),
-	.tp_itemsize = 0,
-	.tp_dealloc = (destructor)Speller_dealloc,
-	.tp_vectorcall_offset = 0,
-	.tp_getattr = nullptr,
-	.tp_setattr = nullptr,
-	.tp_as_async = nullptr,
-	.tp_repr = nullptr,
-	.tp_as_number = nullptr,
-	.tp_as_sequence = nullptr,
-	.tp_as_mapping = nullptr,
-	.tp_hash = nullptr,
-	.tp_call = nullptr,
-	.tp_str = nullptr,
-	.tp_getattro = nullptr,
-	.tp_setattro = nullptr,
-	.tp_as_buffer = nullptr,
-	.tp_flags = Py_TPFLAGS_DEFAULT,
-	.tp_doc = "Python spellchecker with Hunspell as backend",
-	.tp_traverse = nullptr,
-	.tp_clear = nullptr,
-	.tp_richcompare = nullptr,
-	.tp_weaklistoffset = 0,
-	.tp_iter = nullptr,
-	.tp_iternext = nullptr,
-	.tp_methods = Speller_methods,
-	.tp_members = nullptr,
-	.tp_getset = nullptr,
-	.tp_base = nullptr,
-	.tp_dict = nullptr,
-	.tp_descr_get = nullptr,
-	.tp_descr_set = nullptr,
-	.tp_dictoffset = 0,
-	.tp_init = (initproc)Speller_init,
-	.tp_alloc = nullptr,
-	.tp_new = Speller_new,
-	.tp_free = nullptr,
-	.tp_is_gc = nullptr,
-	.tp_bases = nullptr,
-	.tp_mro = nullptr,
-	.tp_cache = nullptr,
-	.tp_subclasses = nullptr,
-	.tp_weaklist = nullptr,
-	.tp_del = nullptr,
-	.tp_version_tag = 0,
-	.tp_finalize = nullptr,
-	.tp_vectorcall = nullptr
+static PyMethodDef sibel_methods[] = {
+	{ "get_thread_pool_size", sibel_get_thread_pool_size, METH_NOARGS, "Get the number of worker threads shared by all spellers" },
+	{ "set_thread_pool_size", sibel_set_thread_pool_size, METH_VARARGS, "Set the number of worker threads shared by all spellers (0 runs everything on the calling thread)" },
+	{ "_after_fork_in_child", sibel_after_fork_in_child, METH_NOARGS, "Start the thread pool again in a child process; registered with os.register_at_fork()" },
+	{ "stats", sibel_stats, METH_NOARGS, "Get the statistics of all spellers together, and of the thread pool" },
+	{ "get_stats_enabled", sibel_get_stats_enabled, METH_NOARGS, "Check whether statistics are being collected" },
+	{ "set_stats_enabled", sibel_set_stats_enabled, METH_VARARGS, "Start or stop collecting statistics" },
+	{ nullptr, nullptr, 0, nullptr }
 };
 
 static struct PyModuleDef sibelmodule = {
 	PyModuleDef_HEAD_INIT,
 	.m_name = "sibel",
 	.m_doc = "Python spellchecker with Hunspell as backend",
-	.m_size = -1
+	.m_size = -1,
+	.m_methods = sibel_methods
 };
 
 PyMODINIT_FUNC PyInit_sibel(void)
 {
 	PyObject * m;
 
-	if (PyType_Ready(&SpellerType) < 0)
+	ResultListType.tp_base = &PyList_Type;
+	if (PyType_Ready(&SpellerType) < 0 || PyType_Ready(&FileCheckType) < 0 || PyType_Ready(&ResultListType) < 0 || PyType_Ready(&CompletionQueueType) < 0 || PyType_Ready(&MultiSpellerType) < 0)
+	{
+		return nullptr;
+	}
+
+	add_reader_name = PyUnicode_InternFromString("add_reader");
+	create_future_name = PyUnicode_InternFromString("create_future");
+	is_closed_name = PyUnicode_InternFromString("is_closed");
+	done_name = PyUnicode_InternFromString("done");
+	set_result_name = PyUnicode_InternFromString("set_result");
+	set_exception_name = PyUnicode_InternFromString("set_exception");
+	if (!add_reader_name || !create_future_name || !is_closed_name || !done_name || !set_result_name || !set_exception_name)
 	{
 		return nullptr;
 	}
@@ -339,15 +3329,55 @@ PyMODINIT_FUNC PyInit_sibel(void)
 		return nullptr;
 	}
 
+	Py_INCREF(&ResultListType);
+	if (PyModule_AddObject(m, "ResultList", (PyObject *)&ResultListType) < 0)
+	{
+		Py_DECREF(&ResultListType);
+		Py_DECREF(&SpellerType);
+		Py_DECREF(m);
+		return nullptr;
+	}
+
+	Py_INCREF(&MultiSpellerType);
+	if (PyModule_AddObject(m, "MultiSpeller", (PyObject *)&MultiSpellerType) < 0)
+	{
+		Py_DECREF(&MultiSpellerType);
+		Py_DECREF(&ResultListType);
+		Py_DECREF(&SpellerType);
+		Py_DECREF(m);
+		return nullptr;
+	}
+
 	DictionaryLoadingError = PyErr_NewException("sibel.DictionaryLoadingError", nullptr, nullptr);
 	Py_INCREF(DictionaryLoadingError);
 	if (PyModule_AddObject(m, "DictionaryLoadingError", DictionaryLoadingError) < 0)
 	{
 		Py_DECREF(DictionaryLoadingError);
+		Py_DECREF(&MultiSpellerType);
+		Py_DECREF(&ResultListType);
 		Py_DECREF(&SpellerType);
 		Py_DECREF(m);
 		return nullptr;
 	}
 
+	// Only the forking thread survives fork(), so the child starts its own workers
+	PyObject * os = PyImport_ImportModule("os");
+	PyObject * register_at_fork = os ? PyObject_GetAttrString(os, "register_at_fork") : nullptr;
+	PyObject * after_in_child = PyObject_GetAttrString(m, "_after_fork_in_child");
+	PyObject * kwargs = after_in_child ? Py_BuildValue("{s:O}", "after_in_child", after_in_child) : nullptr;
+	PyObject * empty = PyTuple_New(0);
+	PyObject * registered = register_at_fork && kwargs && empty ? PyObject_Call(register_at_fork, empty, kwargs) : nullptr;
+	Py_XDECREF(os);
+	Py_XDECREF(register_at_fork);
+	Py_XDECREF(after_in_child);
+	Py_XDECREF(kwargs);
+	Py_XDECREF(empty);
+	if (registered == nullptr)
+	{
+		Py_DECREF(m);
+		return nullptr;
+	}
+	Py_DECREF(registered);
+
 	return m;
 }
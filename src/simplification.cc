@@ -3,6 +3,8 @@
 #include <algorithm>
 #include <array>
 #include <unicode/normalizer2.h>
+#include <unicode/uchar.h>
+#include <unicode/utf8.h>
 
 UErrorCode err = U_ZERO_ERROR;
 const icu::Normalizer2 * normaliser = icu::Normalizer2::getNFKDInstance(err);
@@ -10,12 +12,6 @@ const icu::Normalizer2 * normaliser = icu::Normalizer2::getNFKDInstance(err);
 // Banned: combining characters (M), punctuation (P), and space (Z)
 const icu::UnicodeSet BANNED_SET("[[:M:][:P:][:Z:]]", err);
 
-const icu::UnicodeString LIGATURE_SS(0x1E9E);
-const icu::UnicodeString LIGATURE_ss(0x00DF);
-const icu::UnicodeString LIGATURE_AE(0x00C6);
-const icu::UnicodeString LIGATURE_ae(0x00E6);
-const icu::UnicodeString LIGATURE_OE(0x0152);
-const icu::UnicodeString LIGATURE_oe(0x0153);
 const icu::UnicodeString PLAIN_SS("SS");
 const icu::UnicodeString PLAIN_ss("ss");
 const icu::UnicodeString PLAIN_AE("AE");
@@ -23,47 +19,165 @@ const icu::UnicodeString PLAIN_ae("ae");
 const icu::UnicodeString PLAIN_OE("OE");
 const icu::UnicodeString PLAIN_oe("oe");
 
-std::string simplify(const std::string & s)
+/**
+ * The reference implementation, used for text outside of the lookup table.
+ * NB: char32At() is called on every UTF-16 unit, so a supplementary character that
+ * is kept is appended twice. The fast path must not change this, so it is left as is.
+ */
+static void simplify_with_icu(std::string_view s, std::string &out)
 {
-	icu::UnicodeString us = icu::UnicodeString::fromUTF8(s);
+	thread_local icu::UnicodeString normalised;
+	thread_local icu::UnicodeString result;
 
 	UErrorCode err = U_ZERO_ERROR;
-	icu::UnicodeString normalised = normaliser->normalize(us, err);
+	normaliser->normalize(icu::UnicodeString::fromUTF8(icu::StringPiece(s.data(), static_cast<int32_t>(s.size()))), normalised, err);
 
-	icu::UnicodeString result;
+	result.remove();
 	for (int32_t i = 0; i < normalised.length(); ++i)
 	{
 		UChar32 c = normalised.char32At(i);
-		if (!BANNED_SET.contains(c))
+		if (BANNED_SET.contains(c))
+		{
+			continue;
+		}
+		// The ligatures are not decomposed by NFKD
+		switch (c)
 		{
+		case 0x1E9E:
+			result.append(PLAIN_SS);
+			break;
+		case 0x00DF:
+			result.append(PLAIN_ss);
+			break;
+		case 0x00C6:
+			result.append(PLAIN_AE);
+			break;
+		case 0x00E6:
+			result.append(PLAIN_ae);
+			break;
+		case 0x0152:
+			result.append(PLAIN_OE);
+			break;
+		case 0x0153:
+			result.append(PLAIN_oe);
+			break;
+		default:
 			result.append(c);
 		}
 	}
 
-	// result.toLower();
+	out.clear();
+	result.toUTF8String(out);
+}
 
-	result.findAndReplace(LIGATURE_SS, PLAIN_SS);
-	result.findAndReplace(LIGATURE_ss, PLAIN_ss);
-	result.findAndReplace(LIGATURE_AE, PLAIN_AE);
-	result.findAndReplace(LIGATURE_ae, PLAIN_ae);
-	result.findAndReplace(LIGATURE_OE, PLAIN_OE);
-	result.findAndReplace(LIGATURE_oe, PLAIN_oe);
+/**
+ * The simplified form of every code point below U+0180 (ASCII, Latin-1 and Latin
+ * Extended-A). NFKD only reorders combining marks, which are all removed, so text made
+ * of these code points simplifies to the concatenation of their simplified forms.
+ */
+struct simplified_code_point
+{
+	char bytes[7];
+	unsigned char length; // UNTABULATED if the form does not fit
+};
+
+static const unsigned char UNTABULATED = 0xFF;
+
+static const std::size_t SIMPLIFY_TABLE_SIZE = 0x180;
+
+static const std::array<simplified_code_point, SIMPLIFY_TABLE_SIZE> SIMPLIFY_TABLE = []
+{
+	std::array<simplified_code_point, SIMPLIFY_TABLE_SIZE> table{};
+	std::string simplified;
+	for (UChar32 c = 0; c < static_cast<UChar32>(SIMPLIFY_TABLE_SIZE); ++c)
+	{
+		char buf[U8_MAX_LENGTH];
+		int32_t n = 0;
+		U8_APPEND_UNSAFE(buf, n, c);
+		simplify_with_icu(std::string_view(buf, n), simplified);
+		if (simplified.size() > sizeof(table[c].bytes))
+		{
+			table[c].length = UNTABULATED;
+			continue;
+		}
+		simplified.copy(table[c].bytes, simplified.size());
+		table[c].length = static_cast<unsigned char>(simplified.size());
+	}
+	return table;
+}();
 
-	std::string result_utf8;
-	result.toUTF8String(result_utf8);
-	return result_utf8;
+void simplify(std::string_view s, std::string &out)
+{
+	out.clear();
+	int32_t i = 0;
+	int32_t length = static_cast<int32_t>(s.size());
+	while (i < length)
+	{
+		UChar32 c = static_cast<unsigned char>(s[i]);
+		if (c < 0x80)
+		{
+			++i;
+		}
+		else
+		{
+			U8_NEXT(s.data(), i, length, c);
+		}
+
+		if (c < 0 || c >= static_cast<UChar32>(SIMPLIFY_TABLE_SIZE) || SIMPLIFY_TABLE[c].length == UNTABULATED)
+		{
+			simplify_with_icu(s, out);
+			return;
+		}
+		out.append(SIMPLIFY_TABLE[c].bytes, SIMPLIFY_TABLE[c].length);
+	}
 }
 
-const std::string BANNED_CHARS[] = {" ", "-", "'", "\u2019"};
+std::string simplify(const std::string & s)
+{
+	std::string result;
+	simplify(s, result);
+	return result;
+}
 
 bool is_without_banned_chars(const std::string &s)
 {
-	for (const std::string & c : BANNED_CHARS)
+	return !classify(s).banned;
+}
+
+/**
+ * Lower-cases s into out, also merging the Turkish dotted and dotless i into i.
+ * An incomplete UTF-8 sequence at the end of s is dropped.
+ */
+void fold_case(std::string_view s, std::string &out)
+{
+	out.clear();
+	int32_t i = 0;
+	int32_t length = static_cast<int32_t>(s.size());
+	while (i < length)
 	{
-		if (s.find(c) != std::string::npos)
+		unsigned char b = s[i];
+		if (b < 0x80)
+		{
+			out += static_cast<char>(b >= 'A' && b <= 'Z' ? b + ('a' - 'A') : b);
+			++i;
+			continue;
+		}
+
+		UChar32 c;
+		U8_NEXT(s.data(), i, length, c);
+		if (c < 0)
+		{
+			continue;
+		}
+		c = u_tolower(c);
+		if (c == 0x0130 || c == 0x0131)
 		{
-			return false;
+			c = 'i';
 		}
+
+		char buf[U8_MAX_LENGTH];
+		int32_t n = 0;
+		U8_APPEND_UNSAFE(buf, n, c);
+		out.append(buf, n);
 	}
-	return true;
 }
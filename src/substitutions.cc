@@ -1,427 +1,779 @@
 #include "sibel.h"
 
 #include <algorithm>
+#include <array>
 #include <cctype>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
 
-substitution_table::substitution_table(const std::unordered_map<std::string, std::vector<std::string>> &&table_letters, const std::unordered_map<std::string, std::vector<std::string>> &&table_ligatures) : table_letters(table_letters), table_ligatures(table_ligatures) {}
-
-const std::unordered_map<std::string, substitution_table> SUBSTITUTION_TABLES({
-	// https://en.wikipedia.org/wiki/Afrikaans#Orthography
-	{"af", substitution_table({
-		{"A", {"\u00C1", "\u00C4"}},
-		{"a", {"\u00E1", "\u00E4"}},
-		{"E", {"\u00C8", "\u00C9", "\u00CA", "\u00CB"}},
-		{"e", {"\u00E8", "\u00E9", "\u00EA", "\u00EB"}},
-		{"I", {"\u00CD", "\u00CE", "\u00CF"}},
-		{"i", {"\u00ED", "\u00EE", "\u00EF"}},
-		{"O", {"\u00D3", "\u00D4", "\u00D6"}},
-		{"o", {"\u00F3", "\u00F4", "\u00F6"}},
-		{"U", {"\u00DA", "\u00DB", "\u00DC"}},
-		{"u", {"\u00FA", "\u00FB", "\u00FC"}},
-		{"Y", {"\u00DD"}},
-		{"y", {"\u00FD"}}
-	}, {})},
-
-	// https://en.wikipedia.org/wiki/Czech_orthography#Alphabet
-	// One thing about Czech is unclear at the moment: could U+010F be expanded to d'?
-
-	// https://en.wikipedia.org/wiki/Danish_orthography
-	// Danish has the letter 'slashed o,' and I don't know how it is usually represented with ASCII
-
-	// https://en.wikipedia.org/wiki/German_orthography#Alphabet
-	{"de", substitution_table({
-		{"A", {"\u00C4"}},
-		{"a", {"\u00E4"}},
-		{"O", {"\u00D6"}},
-		{"o", {"\u00F6"}},
-		{"U", {"\u00DC"}},
-		{"u", {"\u00FC"}}
-	}, {
-		{"AE", {"\u00C4"}},
-		{"ae", {"\u00E4"}},
-		{"OE", {"\u00D6"}},
-		{"oe", {"\u00F6"}},
-		{"ss", {"\u00DF"}}, // The capital sharp s is a recent introduction
-		{"UE", {"\u00DC"}},
-		{"ue", {"\u00FC"}}
-	})},
-
-	// https://www.tandem.net/blog/spanish-accents
-	// Spanish could be further optimised because the acute accent only appears once in a word
-	{"es", substitution_table({
-		{"A", {"\u00C1"}},
-		{"a", {"\u00E1"}},
-		{"E", {"\u00C9"}},
-		{"e", {"\u00E9"}},
-		{"I", {"\u00CD"}},
-		{"i", {"\u00ED"}},
-		{"N", {"\u00D1"}},
-		{"n", {"\u00F1"}},
-		{"O", {"\u00D3"}},
-		{"o", {"\u00F3"}},
-		{"U", {"\u00DA", "\u00DC"}},
-		{"u", {"\u00FA", "\u00FC"}}
-	}, {})},
-
-	// https://en.wikipedia.org/wiki/Estonian_orthography
-	{"et", substitution_table({
-		{"A", {"\u00C4"}},
-		{"a", {"\u00E4"}},
-		{"O", {"\u00D5", "\u00D6"}},
-		{"o", {"\u00F5", "\u00F6"}},
-		{"S", {"\u0160"}},
-		{"s", {"\u0161"}},
-		{"U", {"\u00DC"}},
-		{"u", {"\u00FC"}},
-		{"Z", {"\u017D"}},
-		{"z", {"\u017E"}}
-	}, {})},
-
-	// https://en.wikipedia.org/wiki/Finnish_orthography
-	{"fi", substitution_table({
-		{"A", {"\u00C4", "\u00C5"}},
-		{"a", {"\u00E4", "\u00E5"}},
-		{"O", {"\u00D6"}},
-		{"o", {"\u00F6"}},
-		{"S", {"\u0160"}},
-		{"s", {"\u0161"}},
-		{"Z", {"\u017D"}},
-		{"z", {"\u017E"}}
-	}, {})},
-
-	// https://fr.wikipedia.org/wiki/Diacritiques_utilis%C3%A9s_en_fran%C3%A7ais#Combinaisons
-	{"fr", substitution_table({
-		{"A", {"\u00C0", "\u00C2"}},
-		{"a", {"\u00E0", "\u00E2"}},
-		{"C", {"\u00C7"}},
-		{"c", {"\u00E7"}},
-		{"E", {"\u00C8", "\u00C9", "\u00CA", "\u00CB"}},
-		{"e", {"\u00E8", "\u00E9", "\u00EA", "\u00EB"}},
-		{"I", {"\u00CE", "\u00CF"}},
-		{"i", {"\u00EE", "\u00EF"}},
-		{"O", {"\u00D4"}},
-		{"o", {"\u00F4"}},
-		{"U", {"\u00D9", "\u00DB", "\u00DC"}},
-		{"u", {"\u00F9", "\u00FB", "\u00FC"}}
-	}, {
-		{"AE", {"\u00C6"}},
-		{"ae", {"\u00E6"}},
-		{"OE", {"\u0152"}},
-		{"oe", {"\u0153"}}
-	})},
-
-	// https://en.wikipedia.org/wiki/Irish_orthography#Diacritics
-	{"ga", substitution_table({
-		{"A", {"\u00C1"}},
-		{"a", {"\u00E1"}},
-		{"E", {"\u00C9"}},
-		{"e", {"\u00E9"}},
-		{"I", {"\u00CD"}},
-		{"i", {"\u00ED"}},
-		{"O", {"\u00D3"}},
-		{"o", {"\u00F3"}},
-		{"U", {"\u00DA"}},
-		{"u", {"\u00FA"}}
-	}, {})},
-
-	// https://en.wikipedia.org/wiki/Scottish_Gaelic_orthography#Alphabet
-	{"gd", substitution_table({
-		{"A", {"\u00C0"}},
-		{"a", {"\u00E0"}},
-		{"E", {"\u00C8"}},
-		{"e", {"\u00E8"}},
-		{"I", {"\u00CC"}},
-		{"i", {"\u00EC"}},
-		{"O", {"\u00D2"}},
-		{"o", {"\u00F2"}},
-		{"U", {"\u00D9"}},
-		{"u", {"\u00F9"}}
-	}, {})},
-
-	// https://en.wikipedia.org/wiki/Manx_language#Diacritics
-	{"gv", substitution_table({}, {
-		{"Ch", {"\u00C7h"}},
-		{"ch", {"\u00E7h"}}
-	})},
-
-	// https://en.wikipedia.org/wiki/Haitian_Creole#Orthography
-	{"ht", substitution_table({
-		{"E", {"\u00C8"}},
-		{"e", {"\u00E8"}},
-		{"O", {"\u00D2"}},
-		{"o", {"\u00F2"}}
-	}, {})},
-
-	// https://en.wikipedia.org/wiki/Hungarian_alphabet
-	{"hu", substitution_table({
-		{"A", {"\u00C1"}},
-		{"a", {"\u00E1"}},
-		{"E", {"\u00C9"}},
-		{"e", {"\u00E9"}},
-		{"I", {"\u00CD"}},
-		{"i", {"\u00ED"}},
-		{"O", {"\u00D3", "\u00D6", "\u0150"}},
-		{"o", {"\u00F3", "\u00F6", "\u0151"}},
-		{"U", {"\u00DA", "\u00DC", "\u0170"}},
-		{"u", {"\u00FA", "\u00FC", "\u0171"}}
-	}, {})},
-
-	// https://en.wikipedia.org/wiki/Icelandic_language#Writing_system
-	// I don't know how to handle thorns
-
-	// https://www.italianpod101.com/blog/2021/01/18/italian-written-accents/
-	// The Wikipedia article is utterly confusing
-	{"it", substitution_table({
-		{"A", {"\u00C0"}},
-		{"a", {"\u00E0"}},
-		{"E", {"\u00C8", "\u00C9"}},
-		{"e", {"\u00E8", "\u00E9"}},
-		{"I", {"\u00CC"}},
-		{"i", {"\u00EC"}},
-		{"O", {"\u00D2"}},
-		{"o", {"\u00F2"}},
-		{"U", {"\u00D9"}},
-		{"u", {"\u00F9"}}
-	}, {})},
-
-	// https://en.wikipedia.org/wiki/Lithuanian_language#Script
-	{"lt", substitution_table({
-		{"A", {"\u0104"}},
-		{"a", {"\u0105"}},
-		{"C", {"\u010C"}},
-		{"c", {"\u010D"}},
-		{"E", {"\u0116", "\u0118"}},
-		{"e", {"\u0117", "\u0119"}},
-		{"I", {"\u012E"}},
-		{"i", {"\u012F"}},
-		{"S", {"\u0160"}},
-		{"s", {"\u0161"}},
-		{"U", {"\u016A", "\u0172"}},
-		{"u", {"\u016B", "\u0173"}},
-		{"Z", {"\u017D"}},
-		{"z", {"\u017E"}}
-	}, {})},
-
-	// https://en.wikipedia.org/wiki/Latvian_language#Orthography
-	{"lv", substitution_table({
-		{"A", {"\u0100"}},
-		{"a", {"\u0101"}},
-		{"C", {"\u010C"}},
-		{"c", {"\u010D"}},
-		{"E", {"\u0112"}},
-		{"e", {"\u0113"}},
-		{"G", {"\u0122"}},
-		{"g", {"\u0123"}},
-		{"I", {"\u012A"}},
-		{"i", {"\u012B"}},
-		{"K", {"\u0136"}},
-		{"k", {"\u0137"}},
-		{"L", {"\u013B"}},
-		{"l", {"\u013C"}},
-		{"N", {"\u0145"}},
-		{"n", {"\u0146"}},
-		{"S", {"\u0160"}},
-		{"s", {"\u0161"}},
-		{"U", {"\u016A"}},
-		{"u", {"\u016B"}},
-		{"Z", {"\u017D"}},
-		{"z", {"\u017E"}}
-	}, {})},
-
-	// https://en.wikipedia.org/wiki/M%C4%81ori_language#Orthography
-	{"mi", substitution_table({
-		{"A", {"\u0100"}},
-		{"a", {"\u0101"}},
-		{"E", {"\u0112"}},
-		{"e", {"\u0113"}},
-		{"I", {"\u012A"}},
-		{"i", {"\u012B"}},
-		{"O", {"\u014C"}},
-		{"o", {"\u014D"}},
-		{"U", {"\u016A"}},
-		{"u", {"\u016B"}}
-	}, {})},
-
-	// https://en.wikipedia.org/wiki/Maltese_language#Orthography
-	// Only final vowels may take the grave accent. This could be optimised
-	{"mt", substitution_table({
-		{"a", {"\u00E0"}},
-		{"C", {"\u010A"}},
-		{"c", {"\u010B"}},
-		{"e", {"\u00E8"}},
-		{"G", {"\u0120"}},
-		{"g", {"\u0121"}},
-		{"H", {"\u0126"}},
-		{"h", {"\u0127"}},
-		{"i", {"\u00EC"}},
-		{"o", {"\u00F2"}},
-		{"u", {"\u00F9"}},
-		{"Z", {"\u017B"}},
-		{"z", {"\u017C"}}
-	}, {})},
-
-	// https://www.ucl.ac.uk/libnet/library-procedures/collections/cataloguing/dutch-guide-cataloguers
-	{"nl", substitution_table({
-		{"A", {"\u00C1", "\u00C4"}},
-		{"a", {"\u00E1", "\u00E4"}},
-		{"E", {"\u00C9", "\u00CB"}},
-		{"e", {"\u00E9", "\u00EB"}},
-		{"I", {"\u00CD", "\u00CF"}},
-		{"i", {"\u00ED", "\u00EF"}},
-		{"O", {"\u00D3", "\u00D6"}},
-		{"o", {"\u00F3", "\u00F6"}},
-		{"U", {"\u00DA", "\u00DC"}},
-		{"u", {"\u00FA", "\u00FC"}}
-	}, {})},
-
-	// https://en.wikipedia.org/wiki/Norwegian_language#Written_language
-	// The slashed o in Norwegian is again a problem
-
-	// https://en.wikipedia.org/wiki/Polish_alphabet#Letters
-	{"pl", substitution_table({
-		{"A", {"\u0104"}},
-		{"a", {"\u0105"}},
-		{"C", {"\u0106"}},
-		{"c", {"\u0107"}},
-		{"E", {"\u0118"}},
-		{"e", {"\u0119"}},
-		{"L", {"\u0141"}},
-		{"l", {"\u0142"}},
-		{"N", {"\u0143"}},
-		{"n", {"\u0144"}},
-		{"O", {"\u00D3"}},
-		{"o", {"\u00F3"}},
-		{"S", {"\u015A"}},
-		{"s", {"\u015B"}},
-		{"Z", {"\u0179", "\u017B"}},
-		{"z", {"\u017A", "\u017C"}}
-	}, {})},
-
-	// https://en.wikipedia.org/wiki/Portuguese_orthography#Diacritics
-	// I won't include A with a grave accent because no user in the right frame of mind would look up such words
-	{"pt", substitution_table({
-		{"A", {"\u00C1", "\u00C2", "\u00C3"}},
-		{"a", {"\u00E1", "\u00E2", "\u00E3"}},
-		{"C", {"\u00C7"}},
-		{"c", {"\u00E7"}},
-		{"E", {"\u00C9", "\u00CA"}},
-		{"e", {"\u00E9", "\u00EA"}},
-		{"I", {"\u00CD"}},
-		{"i", {"\u00ED"}},
-		{"O", {"\u00D3", "\u00D4", "\u00D5"}},
-		{"o", {"\u00F3", "\u00F4", "\u00F5"}},
-		{"U", {"\u00DA"}},
-		{"u", {"\u00FA"}}
-	}, {})},
-
-	// https://en.wikipedia.org/wiki/Romanian_language#Romanian_alphabet
-	{"ro", substitution_table({
-		{"A", {"\u00C2", "\u0102"}},
-		{"a", {"\u00E2", "\u0103"}},
-		{"I", {"\u00CE"}},
-		{"i", {"\u00EE"}},
-		{"S", {"\u0218"}},
-		{"s", {"\u0219"}},
-		{"T", {"\u021A"}},
-		{"t", {"\u021B"}}
-	}, {})},
-
-	// https://en.wikipedia.org/wiki/Slovak_orthography#Alphabet
-	// Slovak has again the problem of "d'"
-
-	// https://en.wikipedia.org/wiki/Slovene_alphabet#Diacritics
-	// Are diacritics used or not by Hunspell?
-
-	// https://en.wikipedia.org/wiki/Samoan_language#Alphabet
-	// How do you handle the apostrophe?
-
-	// https://en.wikipedia.org/wiki/Albanian_alphabet
-	{"sq", substitution_table({
-		{"C", {"\u00C7"}},
-		{"c", {"\u00E7"}},
-		{"E", {"\u00CB"}},
-		{"e", {"\u00EB"}}
-	}, {})},
-
-	// https://en.wikipedia.org/wiki/Swedish_alphabet#Letters
-	{"sv", substitution_table({
-		{"A", {"\u00C4", "\u00C5"}},
-		{"a", {"\u00E4", "\u00E5"}},
-		{"O", {"\u00D6"}},
-		{"o", {"\u00F6"}}
-	}, {})},
-
-	// https://en.wikipedia.org/wiki/Turkmen_alphabet
-	{"tk", substitution_table({
-		{"A", {"\u00C4"}},
-		{"a", {"\u00E4"}},
-		{"C", {"\u00C7"}},
-		{"c", {"\u00E7"}},
-		{"N", {"\u0147"}},
-		{"n", {"\u0148"}},
-		{"O", {"\u00D6"}},
-		{"o", {"\u00F6"}},
-		{"S", {"\u015E"}},
-		{"s", {"\u015F"}},
-		{"U", {"\u00DC"}},
-		{"u", {"\u00FC"}},
-		{"Y", {"\u00DD"}},
-		{"y", {"\u00FD"}},
-		{"Z", {"\u017D"}},
-		{"z", {"\u017E"}}
-	}, {})},
-
-	// https://en.wikipedia.org/wiki/Filipino_alphabet
-	{"tl", substitution_table({
-		{"N", {"\u00D1"}},
-		{"n", {"\u00F1"}}
-	}, {})},
-
-	// https://en.wikipedia.org/wiki/Turkish_alphabet#Letters
-	{"tr", substitution_table({
-		{"a", {"\u00E2"}},
-		{"C", {"\u00C7"}},
-		{"c", {"\u00E7"}},
-		{"G", {"\u011E"}},
-		{"g", {"\u011F"}},
-		{"I", {"\u0130"}},
-		{"i", {"\u00EE", "\u0131"}},
-		{"O", {"\u00D6"}},
-		{"o", {"\u00F6"}},
-		{"S", {"\u015E"}},
-		{"s", {"\u015F"}},
-		{"U", {"\u00DC"}},
-		{"u", {"\u00FB", "\u00FC"}}
-	}, {})},
-
-	// https://en.wikipedia.org/wiki/Vietnamese_alphabet
-	// It's beyond my ability to handle multiple diacritics
-
-	// https://en.wikipedia.org/wiki/Walloon_alphabet
-	{"wa", substitution_table({
-		{"A", {"\u00C0", "\u00C2", "\u00C5"}},
-		{"a", {"\u00E0", "\u00E2", "\u00E5"}},
-		{"C", {"\u00C7"}},
-		{"c", {"\u00E7"}},
-		{"E", {"\u00C8", "\u00C9", "\u00CA", "\u00CB"}},
-		{"e", {"\u00E8", "\u00E9", "\u00EA", "\u00EB"}},
-		{"I", {"\u00CC", "\u00CE"}},
-		{"i", {"\u00EC", "\u00EE"}},
-		{"O", {"\u00D4", "\u00D6"}},
-		{"o", {"\u00F4", "\u00F6"}},
-		{"U", {"\u00D9", "\u00DB"}},
-		{"u", {"\u00F9", "\u00FB"}}
-	}, {})}
+/**
+ * Sorts the entries of a table by key at compile time, keeping the order of the
+ * values of each key. Keys and values that do not fit fail the compilation.
+ */
+template <std::size_t N>
+static constexpr std::array<substitution_entry, N> sort_entries(const substitution_entry (&entries)[N])
+{
+	std::array<substitution_entry, N> sorted{};
+	for (std::size_t i = 0; i < N; ++i)
+	{
+		if (entries[i].key[sizeof(entries[i].key) - 1] != '\0' || entries[i].value[sizeof(entries[i].value) - 1] != '\0')
+		{
+			throw std::length_error("substitution entry too long");
+		}
+
+		std::size_t j = i;
+		while (j > 0 && entries[i].key_view() < sorted[j - 1].key_view())
+		{
+			sorted[j] = sorted[j - 1];
+			--j;
+		}
+		sorted[j] = entries[i];
+	}
+	return sorted;
+}
+
+static constexpr std::array<substitution_entry, 0> NO_SUBSTITUTIONS{};
+
+// https://en.wikipedia.org/wiki/Afrikaans#Orthography
+static constexpr auto AF_LETTERS = sort_entries({
+	{"A", "\u00C1"}, {"A", "\u00C4"},
+	{"a", "\u00E1"}, {"a", "\u00E4"},
+	{"E", "\u00C8"}, {"E", "\u00C9"}, {"E", "\u00CA"}, {"E", "\u00CB"},
+	{"e", "\u00E8"}, {"e", "\u00E9"}, {"e", "\u00EA"}, {"e", "\u00EB"},
+	{"I", "\u00CD"}, {"I", "\u00CE"}, {"I", "\u00CF"},
+	{"i", "\u00ED"}, {"i", "\u00EE"}, {"i", "\u00EF"},
+	{"O", "\u00D3"}, {"O", "\u00D4"}, {"O", "\u00D6"},
+	{"o", "\u00F3"}, {"o", "\u00F4"}, {"o", "\u00F6"},
+	{"U", "\u00DA"}, {"U", "\u00DB"}, {"U", "\u00DC"},
+	{"u", "\u00FA"}, {"u", "\u00FB"}, {"u", "\u00FC"},
+	{"Y", "\u00DD"},
+	{"y", "\u00FD"}
+});
+
+// https://en.wikipedia.org/wiki/Czech_orthography#Alphabet
+// One thing about Czech is unclear at the moment: could U+010F be expanded to d'?
+
+// https://en.wikipedia.org/wiki/Danish_orthography
+// Danish has the letter 'slashed o,' and I don't know how it is usually represented with ASCII
+
+// https://en.wikipedia.org/wiki/German_orthography#Alphabet
+static constexpr auto DE_LETTERS = sort_entries({
+	{"A", "\u00C4"},
+	{"a", "\u00E4"},
+	{"O", "\u00D6"},
+	{"o", "\u00F6"},
+	{"U", "\u00DC"},
+	{"u", "\u00FC"}
+});
+static constexpr auto DE_LIGATURES = sort_entries({
+	{"AE", "\u00C4"},
+	{"ae", "\u00E4"},
+	{"OE", "\u00D6"},
+	{"oe", "\u00F6"},
+	{"ss", "\u00DF"}, // The capital sharp s is a recent introduction
+	{"UE", "\u00DC"},
+	{"ue", "\u00FC"}
 });
+// No word starts with the sharp s
+static const substitution_constraints DE_CONSTRAINTS = {
+	SIZE_MAX,
+	{},
+	{{{"\u00DF"}, substitution_constraints::word_medial | substitution_constraints::word_final}},
+	{}
+};
+
+// https://www.tandem.net/blog/spanish-accents
+static constexpr auto ES_LETTERS = sort_entries({
+	{"A", "\u00C1"},
+	{"a", "\u00E1"},
+	{"E", "\u00C9"},
+	{"e", "\u00E9"},
+	{"I", "\u00CD"},
+	{"i", "\u00ED"},
+	{"N", "\u00D1"},
+	{"n", "\u00F1"},
+	{"O", "\u00D3"},
+	{"o", "\u00F3"},
+	{"U", "\u00DA"}, {"U", "\u00DC"},
+	{"u", "\u00FA"}, {"u", "\u00FC"}
+});
+// The acute accent only appears once in a word, and with the tilde and the diaeresis no
+// word has more than three diacritics (pedigüeñería)
+static const substitution_constraints ES_CONSTRAINTS = {
+	3,
+	{{{"\u00C1", "\u00E1", "\u00C9", "\u00E9", "\u00CD", "\u00ED", "\u00D3", "\u00F3", "\u00DA", "\u00FA"}, 1}},
+	{},
+	{}
+};
+
+// https://en.wikipedia.org/wiki/Estonian_orthography
+static constexpr auto ET_LETTERS = sort_entries({
+	{"A", "\u00C4"},
+	{"a", "\u00E4"},
+	{"O", "\u00D5"}, {"O", "\u00D6"},
+	{"o", "\u00F5"}, {"o", "\u00F6"},
+	{"S", "\u0160"},
+	{"s", "\u0161"},
+	{"U", "\u00DC"},
+	{"u", "\u00FC"},
+	{"Z", "\u017D"},
+	{"z", "\u017E"}
+});
+
+// https://en.wikipedia.org/wiki/Finnish_orthography
+static constexpr auto FI_LETTERS = sort_entries({
+	{"A", "\u00C4"}, {"A", "\u00C5"},
+	{"a", "\u00E4"}, {"a", "\u00E5"},
+	{"O", "\u00D6"},
+	{"o", "\u00F6"},
+	{"S", "\u0160"},
+	{"s", "\u0161"},
+	{"Z", "\u017D"},
+	{"z", "\u017E"}
+});
+
+// https://fr.wikipedia.org/wiki/Diacritiques_utilis%C3%A9s_en_fran%C3%A7ais#Combinaisons
+static constexpr auto FR_LETTERS = sort_entries({
+	{"A", "\u00C0"}, {"A", "\u00C2"},
+	{"a", "\u00E0"}, {"a", "\u00E2"},
+	{"C", "\u00C7"},
+	{"c", "\u00E7"},
+	{"E", "\u00C8"}, {"E", "\u00C9"}, {"E", "\u00CA"}, {"E", "\u00CB"},
+	{"e", "\u00E8"}, {"e", "\u00E9"}, {"e", "\u00EA"}, {"e", "\u00EB"},
+	{"I", "\u00CE"}, {"I", "\u00CF"},
+	{"i", "\u00EE"}, {"i", "\u00EF"},
+	{"O", "\u00D4"},
+	{"o", "\u00F4"},
+	{"U", "\u00D9"}, {"U", "\u00DB"}, {"U", "\u00DC"},
+	{"u", "\u00F9"}, {"u", "\u00FB"}, {"u", "\u00FC"}
+});
+static constexpr auto FR_LIGATURES = sort_entries({
+	{"AE", "\u00C6"},
+	{"ae", "\u00E6"},
+	{"OE", "\u0152"},
+	{"oe", "\u0153"}
+});
+// The cedilla only comes before a, o and u
+static const substitution_constraints FR_CONSTRAINTS = {
+	SIZE_MAX,
+	{},
+	{},
+	{
+		"\u00E7e", "\u00E7\u00E8", "\u00E7\u00E9", "\u00E7\u00EA", "\u00E7\u00EB", "\u00E7i", "\u00E7\u00EE", "\u00E7\u00EF",
+		"\u00C7e", "\u00C7\u00E8", "\u00C7\u00E9", "\u00C7\u00EA", "\u00C7\u00EB", "\u00C7i", "\u00C7\u00EE", "\u00C7\u00EF",
+		"\u00C7E", "\u00C7\u00C8", "\u00C7\u00C9", "\u00C7\u00CA", "\u00C7\u00CB", "\u00C7I", "\u00C7\u00CE", "\u00C7\u00CF"
+	}
+};
+
+// https://en.wikipedia.org/wiki/Irish_orthography#Diacritics
+static constexpr auto GA_LETTERS = sort_entries({
+	{"A", "\u00C1"},
+	{"a", "\u00E1"},
+	{"E", "\u00C9"},
+	{"e", "\u00E9"},
+	{"I", "\u00CD"},
+	{"i", "\u00ED"},
+	{"O", "\u00D3"},
+	{"o", "\u00F3"},
+	{"U", "\u00DA"},
+	{"u", "\u00FA"}
+});
+
+// https://en.wikipedia.org/wiki/Scottish_Gaelic_orthography#Alphabet
+static constexpr auto GD_LETTERS = sort_entries({
+	{"A", "\u00C0"},
+	{"a", "\u00E0"},
+	{"E", "\u00C8"},
+	{"e", "\u00E8"},
+	{"I", "\u00CC"},
+	{"i", "\u00EC"},
+	{"O", "\u00D2"},
+	{"o", "\u00F2"},
+	{"U", "\u00D9"},
+	{"u", "\u00F9"}
+});
+
+// https://en.wikipedia.org/wiki/Manx_language#Diacritics
+static constexpr auto GV_LIGATURES = sort_entries({
+	{"Ch", "\u00C7h"},
+	{"ch", "\u00E7h"}
+});
+
+// https://en.wikipedia.org/wiki/Haitian_Creole#Orthography
+static constexpr auto HT_LETTERS = sort_entries({
+	{"E", "\u00C8"},
+	{"e", "\u00E8"},
+	{"O", "\u00D2"},
+	{"o", "\u00F2"}
+});
+
+// https://en.wikipedia.org/wiki/Hungarian_alphabet
+static constexpr auto HU_LETTERS = sort_entries({
+	{"A", "\u00C1"},
+	{"a", "\u00E1"},
+	{"E", "\u00C9"},
+	{"e", "\u00E9"},
+	{"I", "\u00CD"},
+	{"i", "\u00ED"},
+	{"O", "\u00D3"}, {"O", "\u00D6"}, {"O", "\u0150"},
+	{"o", "\u00F3"}, {"o", "\u00F6"}, {"o", "\u0151"},
+	{"U", "\u00DA"}, {"U", "\u00DC"}, {"U", "\u0170"},
+	{"u", "\u00FA"}, {"u", "\u00FC"}, {"u", "\u0171"}
+});
+
+// https://en.wikipedia.org/wiki/Icelandic_language#Writing_system
+// I don't know how to handle thorns
+
+// https://www.italianpod101.com/blog/2021/01/18/italian-written-accents/
+// The Wikipedia article is utterly confusing
+static constexpr auto IT_LETTERS = sort_entries({
+	{"A", "\u00C0"},
+	{"a", "\u00E0"},
+	{"E", "\u00C8"}, {"E", "\u00C9"},
+	{"e", "\u00E8"}, {"e", "\u00E9"},
+	{"I", "\u00CC"},
+	{"i", "\u00EC"},
+	{"O", "\u00D2"},
+	{"o", "\u00F2"},
+	{"U", "\u00D9"},
+	{"u", "\u00F9"}
+});
+
+// https://en.wikipedia.org/wiki/Lithuanian_language#Script
+static constexpr auto LT_LETTERS = sort_entries({
+	{"A", "\u0104"},
+	{"a", "\u0105"},
+	{"C", "\u010C"},
+	{"c", "\u010D"},
+	{"E", "\u0116"}, {"E", "\u0118"},
+	{"e", "\u0117"}, {"e", "\u0119"},
+	{"I", "\u012E"},
+	{"i", "\u012F"},
+	{"S", "\u0160"},
+	{"s", "\u0161"},
+	{"U", "\u016A"}, {"U", "\u0172"},
+	{"u", "\u016B"}, {"u", "\u0173"},
+	{"Z", "\u017D"},
+	{"z", "\u017E"}
+});
+
+// https://en.wikipedia.org/wiki/Latvian_language#Orthography
+static constexpr auto LV_LETTERS = sort_entries({
+	{"A", "\u0100"},
+	{"a", "\u0101"},
+	{"C", "\u010C"},
+	{"c", "\u010D"},
+	{"E", "\u0112"},
+	{"e", "\u0113"},
+	{"G", "\u0122"},
+	{"g", "\u0123"},
+	{"I", "\u012A"},
+	{"i", "\u012B"},
+	{"K", "\u0136"},
+	{"k", "\u0137"},
+	{"L", "\u013B"},
+	{"l", "\u013C"},
+	{"N", "\u0145"},
+	{"n", "\u0146"},
+	{"S", "\u0160"},
+	{"s", "\u0161"},
+	{"U", "\u016A"},
+	{"u", "\u016B"},
+	{"Z", "\u017D"},
+	{"z", "\u017E"}
+});
+
+// https://en.wikipedia.org/wiki/M%C4%81ori_language#Orthography
+static constexpr auto MI_LETTERS = sort_entries({
+	{"A", "\u0100"},
+	{"a", "\u0101"},
+	{"E", "\u0112"},
+	{"e", "\u0113"},
+	{"I", "\u012A"},
+	{"i", "\u012B"},
+	{"O", "\u014C"},
+	{"o", "\u014D"},
+	{"U", "\u016A"},
+	{"u", "\u016B"}
+});
+
+// https://en.wikipedia.org/wiki/Maltese_language#Orthography
+static constexpr auto MT_LETTERS = sort_entries({
+	{"a", "\u00E0"},
+	{"C", "\u010A"},
+	{"c", "\u010B"},
+	{"e", "\u00E8"},
+	{"G", "\u0120"},
+	{"g", "\u0121"},
+	{"H", "\u0126"},
+	{"h", "\u0127"},
+	{"i", "\u00EC"},
+	{"o", "\u00F2"},
+	{"u", "\u00F9"},
+	{"Z", "\u017B"},
+	{"z", "\u017C"}
+});
+
+// https://www.ucl.ac.uk/libnet/library-procedures/collections/cataloguing/dutch-guide-cataloguers
+static constexpr auto NL_LETTERS = sort_entries({
+	{"A", "\u00C1"}, {"A", "\u00C4"},
+	{"a", "\u00E1"}, {"a", "\u00E4"},
+	{"E", "\u00C9"}, {"E", "\u00CB"},
+	{"e", "\u00E9"}, {"e", "\u00EB"},
+	{"I", "\u00CD"}, {"I", "\u00CF"},
+	{"i", "\u00ED"}, {"i", "\u00EF"},
+	{"O", "\u00D3"}, {"O", "\u00D6"},
+	{"o", "\u00F3"}, {"o", "\u00F6"},
+	{"U", "\u00DA"}, {"U", "\u00DC"},
+	{"u", "\u00FA"}, {"u", "\u00FC"}
+});
+
+// https://en.wikipedia.org/wiki/Norwegian_language#Written_language
+// The slashed o in Norwegian is again a problem
+
+// https://en.wikipedia.org/wiki/Polish_alphabet#Letters
+static constexpr auto PL_LETTERS = sort_entries({
+	{"A", "\u0104"},
+	{"a", "\u0105"},
+	{"C", "\u0106"},
+	{"c", "\u0107"},
+	{"E", "\u0118"},
+	{"e", "\u0119"},
+	{"L", "\u0141"},
+	{"l", "\u0142"},
+	{"N", "\u0143"},
+	{"n", "\u0144"},
+	{"O", "\u00D3"},
+	{"o", "\u00F3"},
+	{"S", "\u015A"},
+	{"s", "\u015B"},
+	{"Z", "\u0179"}, {"Z", "\u017B"},
+	{"z", "\u017A"}, {"z", "\u017C"}
+});
+
+// https://en.wikipedia.org/wiki/Portuguese_orthography#Diacritics
+// I won't include A with a grave accent because no user in the right frame of mind would look up such words
+static constexpr auto PT_LETTERS = sort_entries({
+	{"A", "\u00C1"}, {"A", "\u00C2"}, {"A", "\u00C3"},
+	{"a", "\u00E1"}, {"a", "\u00E2"}, {"a", "\u00E3"},
+	{"C", "\u00C7"},
+	{"c", "\u00E7"},
+	{"E", "\u00C9"}, {"E", "\u00CA"},
+	{"e", "\u00E9"}, {"e", "\u00EA"},
+	{"I", "\u00CD"},
+	{"i", "\u00ED"},
+	{"O", "\u00D3"}, {"O", "\u00D4"}, {"O", "\u00D5"},
+	{"o", "\u00F3"}, {"o", "\u00F4"}, {"o", "\u00F5"},
+	{"U", "\u00DA"},
+	{"u", "\u00FA"}
+});
+// Only one syllable takes the acute or circumflex accent, and the cedilla only comes before a, o and u
+static const substitution_constraints PT_CONSTRAINTS = {
+	SIZE_MAX,
+	{{{"\u00C1", "\u00E1", "\u00C2", "\u00E2", "\u00C9", "\u00E9", "\u00CA", "\u00EA", "\u00CD", "\u00ED", "\u00D3", "\u00F3", "\u00D4", "\u00F4", "\u00DA", "\u00FA"}, 1}},
+	{},
+	{
+		"\u00E7e", "\u00E7\u00E9", "\u00E7\u00EA", "\u00E7i", "\u00E7\u00ED",
+		"\u00C7e", "\u00C7\u00E9", "\u00C7\u00EA", "\u00C7i", "\u00C7\u00ED",
+		"\u00C7E", "\u00C7\u00C9", "\u00C7\u00CA", "\u00C7I", "\u00C7\u00CD"
+	}
+};
+
+// https://en.wikipedia.org/wiki/Romanian_language#Romanian_alphabet
+static constexpr auto RO_LETTERS = sort_entries({
+	{"A", "\u00C2"}, {"A", "\u0102"},
+	{"a", "\u00E2"}, {"a", "\u0103"},
+	{"I", "\u00CE"},
+	{"i", "\u00EE"},
+	{"S", "\u0218"},
+	{"s", "\u0219"},
+	{"T", "\u021A"},
+	{"t", "\u021B"}
+});
+
+// https://en.wikipedia.org/wiki/Slovak_orthography#Alphabet
+// Slovak has again the problem of "d'"
+
+// https://en.wikipedia.org/wiki/Slovene_alphabet#Diacritics
+// Are diacritics used or not by Hunspell?
+
+// https://en.wikipedia.org/wiki/Samoan_language#Alphabet
+// How do you handle the apostrophe?
+
+// https://en.wikipedia.org/wiki/Albanian_alphabet
+static constexpr auto SQ_LETTERS = sort_entries({
+	{"C", "\u00C7"},
+	{"c", "\u00E7"},
+	{"E", "\u00CB"},
+	{"e", "\u00EB"}
+});
+
+// https://en.wikipedia.org/wiki/Swedish_alphabet#Letters
+static constexpr auto SV_LETTERS = sort_entries({
+	{"A", "\u00C4"}, {"A", "\u00C5"},
+	{"a", "\u00E4"}, {"a", "\u00E5"},
+	{"O", "\u00D6"},
+	{"o", "\u00F6"}
+});
+
+// https://en.wikipedia.org/wiki/Turkmen_alphabet
+static constexpr auto TK_LETTERS = sort_entries({
+	{"A", "\u00C4"},
+	{"a", "\u00E4"},
+	{"C", "\u00C7"},
+	{"c", "\u00E7"},
+	{"N", "\u0147"},
+	{"n", "\u0148"},
+	{"O", "\u00D6"},
+	{"o", "\u00F6"},
+	{"S", "\u015E"},
+	{"s", "\u015F"},
+	{"U", "\u00DC"},
+	{"u", "\u00FC"},
+	{"Y", "\u00DD"},
+	{"y", "\u00FD"},
+	{"Z", "\u017D"},
+	{"z", "\u017E"}
+});
+
+// https://en.wikipedia.org/wiki/Filipino_alphabet
+static constexpr auto TL_LETTERS = sort_entries({
+	{"N", "\u00D1"},
+	{"n", "\u00F1"}
+});
+
+// https://en.wikipedia.org/wiki/Turkish_alphabet#Letters
+static constexpr auto TR_LETTERS = sort_entries({
+	{"a", "\u00E2"},
+	{"C", "\u00C7"},
+	{"c", "\u00E7"},
+	{"G", "\u011E"},
+	{"g", "\u011F"},
+	{"I", "\u0130"},
+	{"i", "\u00EE"}, {"i", "\u0131"},
+	{"O", "\u00D6"},
+	{"o", "\u00F6"},
+	{"S", "\u015E"},
+	{"s", "\u015F"},
+	{"U", "\u00DC"},
+	{"u", "\u00FB"}, {"u", "\u00FC"}
+});
+
+// https://en.wikipedia.org/wiki/Vietnamese_alphabet
+// It's beyond my ability to handle multiple diacritics
+
+// https://en.wikipedia.org/wiki/Walloon_alphabet
+static constexpr auto WA_LETTERS = sort_entries({
+	{"A", "\u00C0"}, {"A", "\u00C2"}, {"A", "\u00C5"},
+	{"a", "\u00E0"}, {"a", "\u00E2"}, {"a", "\u00E5"},
+	{"C", "\u00C7"},
+	{"c", "\u00E7"},
+	{"E", "\u00C8"}, {"E", "\u00C9"}, {"E", "\u00CA"}, {"E", "\u00CB"},
+	{"e", "\u00E8"}, {"e", "\u00E9"}, {"e", "\u00EA"}, {"e", "\u00EB"},
+	{"I", "\u00CC"}, {"I", "\u00CE"},
+	{"i", "\u00EC"}, {"i", "\u00EE"},
+	{"O", "\u00D4"}, {"O", "\u00D6"},
+	{"o", "\u00F4"}, {"o", "\u00F6"},
+	{"U", "\u00D9"}, {"U", "\u00DB"},
+	{"u", "\u00F9"}, {"u", "\u00FB"}
+});
+
+/**
+ * The entries of a built-in table, compiled into a substitution_table when first used.
+ */
+struct language_table
+{
+	char code[3];
+	const substitution_entry *letters;
+	std::size_t n_letters;
+	const substitution_entry *ligatures;
+	std::size_t n_ligatures;
+	const substitution_constraints *constraints;
+
+	template <std::size_t L, std::size_t G>
+	constexpr language_table(const char (&code)[3], const std::array<substitution_entry, L> &letters, const std::array<substitution_entry, G> &ligatures, const substitution_constraints *constraints = nullptr)
+		: code{code[0], code[1], code[2]}, letters(letters.data()), n_letters(L), ligatures(ligatures.data()), n_ligatures(G), constraints(constraints)
+	{
+	}
+
+	std::vector<std::pair<std::string, std::string>> entries() const
+	{
+		std::vector<std::pair<std::string, std::string>> result;
+		for (std::size_t i = 0; i < n_letters; ++i)
+		{
+			result.emplace_back(letters[i].key_view(), letters[i].value_view());
+		}
+		for (std::size_t i = 0; i < n_ligatures; ++i)
+		{
+			result.emplace_back(ligatures[i].key_view(), ligatures[i].value_view());
+		}
+		return result;
+	}
+};
+
+// Sorted by language code
+static constexpr language_table LANGUAGES[] = {
+	{"af", AF_LETTERS, NO_SUBSTITUTIONS},
+	{"de", DE_LETTERS, DE_LIGATURES, &DE_CONSTRAINTS},
+	{"es", ES_LETTERS, NO_SUBSTITUTIONS, &ES_CONSTRAINTS},
+	{"et", ET_LETTERS, NO_SUBSTITUTIONS},
+	{"fi", FI_LETTERS, NO_SUBSTITUTIONS},
+	{"fr", FR_LETTERS, FR_LIGATURES, &FR_CONSTRAINTS},
+	{"ga", GA_LETTERS, NO_SUBSTITUTIONS},
+	{"gd", GD_LETTERS, NO_SUBSTITUTIONS},
+	{"gv", NO_SUBSTITUTIONS, GV_LIGATURES},
+	{"ht", HT_LETTERS, NO_SUBSTITUTIONS},
+	{"hu", HU_LETTERS, NO_SUBSTITUTIONS},
+	{"it", IT_LETTERS, NO_SUBSTITUTIONS},
+	{"lt", LT_LETTERS, NO_SUBSTITUTIONS},
+	{"lv", LV_LETTERS, NO_SUBSTITUTIONS},
+	{"mi", MI_LETTERS, NO_SUBSTITUTIONS},
+	{"mt", MT_LETTERS, NO_SUBSTITUTIONS},
+	{"nl", NL_LETTERS, NO_SUBSTITUTIONS},
+	{"pl", PL_LETTERS, NO_SUBSTITUTIONS},
+	{"pt", PT_LETTERS, NO_SUBSTITUTIONS, &PT_CONSTRAINTS},
+	{"ro", RO_LETTERS, NO_SUBSTITUTIONS},
+	{"sq", SQ_LETTERS, NO_SUBSTITUTIONS},
+	{"sv", SV_LETTERS, NO_SUBSTITUTIONS},
+	{"tk", TK_LETTERS, NO_SUBSTITUTIONS},
+	{"tl", TL_LETTERS, NO_SUBSTITUTIONS},
+	{"tr", TR_LETTERS, NO_SUBSTITUTIONS},
+	{"wa", WA_LETTERS, NO_SUBSTITUTIONS}
+};
+
+static constexpr bool is_sorted_by_code()
+{
+	for (std::size_t i = 1; i < std::size(LANGUAGES); ++i)
+	{
+		if (!(std::string_view(LANGUAGES[i - 1].code) < std::string_view(LANGUAGES[i].code)))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static_assert(is_sorted_by_code(), "LANGUAGES must be sorted by language code");
+
+const substitution_table *substitution_table::find(std::string_view lang_code)
+{
+	auto it = std::lower_bound(std::begin(LANGUAGES), std::end(LANGUAGES), lang_code, [](const language_table &language, std::string_view code)
+	{
+		return std::string_view(language.code) < code;
+	});
+	if (it == std::end(LANGUAGES) || std::string_view(it->code) != lang_code)
+	{
+		return nullptr;
+	}
+
+	// Only the languages in use are compiled, and then kept for the lifetime of the process
+	static std::unique_ptr<substitution_table> tables[std::size(LANGUAGES)];
+	static std::once_flag compiled[std::size(LANGUAGES)];
+	std::size_t i = it - std::begin(LANGUAGES);
+	std::call_once(compiled[i], [it, i]
+	{
+		tables[i] = std::make_unique<substitution_table>(it->entries(), it->constraints ? *it->constraints : substitution_constraints());
+	});
+	return tables[i].get();
+}
+
+namespace
+{
+	bool parse_count(std::istringstream &fields, std::size_t &count)
+	{
+		std::string field;
+		if (!(fields >> field) || field.find_first_not_of("0123456789") != std::string::npos || field.size() > 9)
+		{
+			return false;
+		}
+		count = std::stoul(field);
+		return true;
+	}
+
+	bool parse_positions(std::istringstream &fields, unsigned &positions)
+	{
+		std::string field;
+		if (!(fields >> field))
+		{
+			return false;
+		}
+		positions = 0;
+		std::istringstream names(field);
+		std::string name;
+		while (std::getline(names, name, ','))
+		{
+			if (name == "initial")
+			{
+				positions |= substitution_constraints::word_initial;
+			}
+			else if (name == "medial")
+			{
+				positions |= substitution_constraints::word_medial;
+			}
+			else if (name == "final")
+			{
+				positions |= substitution_constraints::word_final;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		return positions != 0;
+	}
+
+	/**
+	 * Reads the rest of a line starting with '@' into constraints.
+	 */
+	bool parse_constraint(const std::string &directive, std::istringstream &fields, substitution_constraints &constraints, std::string &error)
+	{
+		std::vector<std::string> strings;
+		auto read_strings = [&fields, &strings]()
+		{
+			std::string field;
+			while (fields >> field)
+			{
+				strings.push_back(field);
+			}
+			return !strings.empty();
+		};
+
+		if (directive == "@max")
+		{
+			std::string rest;
+			if (!parse_count(fields, constraints.max_substitutions) || fields >> rest)
+			{
+				error = "@max takes a number";
+				return false;
+			}
+		}
+		else if (directive == "@limit")
+		{
+			std::size_t max_count;
+			if (!parse_count(fields, max_count) || !read_strings())
+			{
+				error = "@limit takes a number and the strings it limits";
+				return false;
+			}
+			constraints.limits.push_back({std::move(strings), max_count});
+		}
+		else if (directive == "@place")
+		{
+			unsigned positions;
+			if (!parse_positions(fields, positions) || !read_strings())
+			{
+				error = "@place takes positions (initial, medial, final, joined by commas) and the strings they apply to";
+				return false;
+			}
+			constraints.placements.push_back({std::move(strings), positions});
+		}
+		else if (directive == "@forbid")
+		{
+			if (!read_strings())
+			{
+				error = "@forbid takes the sequences it forbids";
+				return false;
+			}
+			constraints.forbidden.insert(constraints.forbidden.end(), strings.begin(), strings.end());
+		}
+		else
+		{
+			error = "unknown constraint '" + directive + "'";
+			return false;
+		}
+		return true;
+	}
+
+	bool parse_table(const std::string &text, std::vector<std::pair<std::string, std::string>> &entries, substitution_constraints &constraints, std::string &error)
+	{
+		std::istringstream lines(text);
+		std::string line;
+		for (std::size_t line_number = 1; std::getline(lines, line); ++line_number)
+		{
+			line.erase(std::min(line.find('#'), line.size()));
+			std::istringstream fields(line);
+			std::string key;
+			if (!(fields >> key))
+			{
+				continue;
+			}
+
+			std::string where = "line " + std::to_string(line_number) + ": ";
+			if (key.size() > 1 && key[0] == '@')
+			{
+				if (!parse_constraint(key, fields, constraints, error))
+				{
+					error = where + error;
+					return false;
+				}
+				continue;
+			}
+			if (!substitution_table::is_substitutable(key))
+			{
+				error = where + "keys must be printable ASCII characters";
+				return false;
+			}
+
+			std::string value;
+			std::size_t n_values = 0;
+			while (fields >> value)
+			{
+				entries.emplace_back(key, value);
+				++n_values;
+			}
+			if (n_values == 0)
+			{
+				error = where + "no replacement for '" + key + "'";
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+const substitution_table *substitution_table::load(const std::filesystem::path &path, std::string &error)
+{
+	static std::mutex mutex;
+	static std::map<std::string, std::unique_ptr<substitution_table>> tables; // by file content
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		error = "Cannot open " + path.u8string();
+		return nullptr;
+	}
+	std::ostringstream content;
+	content << file.rdbuf();
+	std::string text = content.str();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = tables.find(text);
+	if (it == tables.end())
+	{
+		std::vector<std::pair<std::string, std::string>> entries;
+		substitution_constraints constraints;
+		if (!parse_table(text, entries, constraints, error))
+		{
+			error = path.u8string() + ", " + error;
+			return nullptr;
+		}
+		auto table = std::make_unique<substitution_table>(entries, std::move(constraints));
+		it = tables.emplace(std::move(text), std::move(table)).first;
+	}
+	return it->second.get();
+}
 
 bool substitution_table::is_substitutable(const std::string &s)
 {
 	// If the input goes out of the range of printable ASCII, then it means the user knows what they're doing.
-	return std::all_of(s.cbegin(), s.cend(), [](unsigned char c)
-					   { return std::isprint(c); }) &&
 	// Strings with spaces can't be checked anyway
-		   std::none_of(s.cbegin(), s.cend(), [](unsigned char c)
-						{ return std::isspace(c); });
+	return classify(s).printable_ascii;
 }
 
 /**
@@ -430,65 +782,371 @@ bool substitution_table::is_substitutable(const std::string &s)
  * Then the number of possible substitutions for a string of length n is 2^n.
  * If n is too large, then the time spent in checking all the substitutions might exceed
  * the time obtaining the suggestions from Hunspell.
- * Also if there are too many threads, then we might get an exception
- * (std::system_error Resource temporarily unavailable).
  * 
  * Then I run some simple empirical tests and decided that 8 would guarantee performance
- * in most cases while also not causing exceptions. (On my system an exception is thrown
- * when the number of threads exceeds ~1000. If the user loads three dictionaries with
- * substitution tables, then the number of threads would be 3 * 2^8 = 768. On the other
- * hand, if only one is loaded, we are wasting resources... but it's better to be safe
- * than sorry, right?)
+ * in most cases. (The candidates used to be checked on one thread each, which also made
+ * larger values throw std::system_error; they are now checked on the shared thread pool.)
  */
 const std::size_t substitution_table::SUBSTITUTION_MAX_LENGTH = 8;
 
-void substitution_table::generate_substitutions(const std::unordered_map<std::string, std::vector<std::string>> &map, const std::string &input, std::vector<std::string> &result, std::string::size_type index, std::string current, std::string::size_type len_of_key)
+const std::size_t substitution_table::PRUNED_SUBSTITUTION_MAX_LENGTH = 32;
+
+substitution_table::substitution_table(const std::vector<std::pair<std::string, std::string>> &entries, substitution_constraints constraints) : nodes(1), may_repeat(false), constraints(std::move(constraints))
 {
-	if (index == input.size())
+	// The values of each key in order, without repeats or values the key already stands for
+	std::vector<std::pair<std::string, std::vector<std::string>>> keys;
+	std::map<std::string, std::size_t> key_numbers;
+	for (const auto &[key, value] : entries)
 	{
-		result.push_back(current);
+		auto [it, inserted] = key_numbers.emplace(key, keys.size());
+		if (inserted)
+		{
+			keys.emplace_back(key, std::vector<std::string>());
+		}
+		std::vector<std::string> &key_values = keys[it->second].second;
+		if (value != key && std::find(key_values.begin(), key_values.end(), value) == key_values.end())
+		{
+			key_values.push_back(value);
+		}
 	}
-	else
+
+	auto add = [this](const std::string &key, const std::vector<std::string> &key_values)
+	{
+		std::uint32_t n = 0;
+		for (unsigned char c : key)
+		{
+			if (nodes[n].next[c] == 0)
+			{
+				nodes[n].next[c] = static_cast<std::uint32_t>(nodes.size());
+				nodes.emplace_back();
+			}
+			n = nodes[n].next[c];
+		}
+		nodes[n].values_begin = static_cast<std::uint32_t>(values.size());
+		values.insert(values.end(), key_values.begin(), key_values.end());
+		nodes[n].values_end = static_cast<std::uint32_t>(values.size());
+	};
+
+	// Single characters go in first, so that the values of the longer keys can be run through them
+	for (const auto &[key, key_values] : keys)
 	{
-		std::string current_chars(input.substr(index, len_of_key));
-		generate_substitutions(map, input, result, index + 1, current + input[index], len_of_key);
-		if (map.find(current_chars) != map.end())
+		if (key.size() == 1)
 		{
-			for (const std::string &s : map.at(current_chars))
+			add(key, key_values);
+
+			// Candidates can only repeat if one choice for the character is a prefix of another
+			std::vector<std::string> choices(key_values);
+			choices.push_back(key);
+			for (const std::string &a : choices)
 			{
-				generate_substitutions(map, input, result, index + len_of_key, current + s, len_of_key);
+				for (const std::string &b : choices)
+				{
+					may_repeat |= &a != &b && b.compare(0, a.size(), a) == 0;
+				}
 			}
 		}
 	}
+	for (const auto &[key, key_values] : keys)
+	{
+		if (key.size() > 1)
+		{
+			std::vector<std::string> expanded;
+			std::string current;
+			for (const std::string &value : key_values)
+			{
+				generate_substitutions(value, 0, current, [&expanded](const std::string &s)
+				{
+					if (std::find(expanded.begin(), expanded.end(), s) == expanded.end())
+					{
+						expanded.push_back(s);
+					}
+				}, nullptr, nullptr);
+			}
+			add(key, expanded);
+
+			// A longer key can give what shorter ones give together
+			may_repeat = true;
+		}
+	}
+
+	compile_constraints();
 }
 
-std::vector<std::string> substitution_table::substitute(const std::string &original) const
+/**
+ * Works out once what each value counts for under the constraints, and how long the
+ * words can be for the worst case to stay that of an unconstrained table.
+ */
+void substitution_table::compile_constraints()
 {
-	// std::string lower(original);
-	// std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c)
-	// 			   { return std::tolower(c); });
+	constrained = constraints.max_substitutions != SIZE_MAX || !constraints.limits.empty() || !constraints.placements.empty() || !constraints.forbidden.empty();
+
+	auto occurrences = [](const std::string &value, const std::string &s)
+	{
+		std::size_t n = 0;
+		for (std::string::size_type i = value.find(s); !s.empty() && i != std::string::npos; i = value.find(s, i + s.size()))
+		{
+			++n;
+		}
+		return n;
+	};
+
+	for (const std::string &sequence : constraints.forbidden)
+	{
+		if (!sequence.empty())
+		{
+			forbidden.push_back(sequence);
+		}
+	}
+	std::stable_sort(forbidden.begin(), forbidden.end(), [](const std::string &a, const std::string &b)
+	{
+		return static_cast<unsigned char>(a.back()) < static_cast<unsigned char>(b.back());
+	});
+	std::size_t next = 0;
+	for (std::size_t byte = 0; byte <= 256; ++byte)
+	{
+		while (next < forbidden.size() && static_cast<unsigned char>(forbidden[next].back()) < byte)
+		{
+			++next;
+		}
+		forbidden_ends[byte] = static_cast<std::uint32_t>(next);
+	}
 
-	std::vector<std::string> ligs;
-	if (table_ligatures.empty())
+	value_positions.assign(values.size(), substitution_constraints::anywhere);
+	value_counts.assign(values.size() * constraints.limits.size(), 0);
+	for (std::size_t v = 0; v < values.size(); ++v)
 	{
-		ligs.push_back(std::move(original));
+		for (const substitution_constraints::placement &placement : constraints.placements)
+		{
+			for (const std::string &s : placement.strings)
+			{
+				if (occurrences(values[v], s) > 0)
+				{
+					value_positions[v] &= placement.positions;
+				}
+			}
+		}
+		for (std::size_t l = 0; l < constraints.limits.size(); ++l)
+		{
+			for (const std::string &s : constraints.limits[l].strings)
+			{
+				value_counts[v * constraints.limits.size() + l] += occurrences(values[v], s);
+			}
+		}
 	}
-	else
+
+	length_limit = SUBSTITUTION_MAX_LENGTH;
+	if (constraints.max_substitutions == SIZE_MAX)
 	{
-		generate_substitutions(table_ligatures, original, ligs, 0, "", 2);
+		return;
 	}
 
-	if (table_letters.empty())
+	// The most values that can start at one position of a word
+	std::function<std::size_t(std::uint32_t)> values_below = [this, &values_below](std::uint32_t n)
+	{
+		std::size_t count = nodes[n].values_end - nodes[n].values_begin;
+		for (std::uint32_t next : nodes[n].next)
+		{
+			count += next ? values_below(next) : 0;
+		}
+		return count;
+	};
+	double choices = 0;
+	for (std::uint32_t next : nodes[0].next)
 	{
-		return ligs;
+		choices = std::max(choices, next ? static_cast<double>(values_below(next)) : 0.0);
 	}
-	else
+
+	// At most sum over k <= max_substitutions of C(length, k) * choices^k candidates
+	auto worst_case = [&](std::size_t length)
 	{
-		std::vector<std::string> result;
-		for (const std::string &s : ligs)
+		double total = 0;
+		double term = 1;
+		for (std::size_t k = 0; k <= std::min(length, constraints.max_substitutions); ++k)
 		{
-			generate_substitutions(table_letters, s, result, 0, "", 1);
+			total += term;
+			term = term * (length - k) / (k + 1) * choices;
 		}
-		return result;
+		return total;
+	};
+	double budget = std::pow(choices + 1, static_cast<double>(SUBSTITUTION_MAX_LENGTH));
+	while (length_limit < PRUNED_SUBSTITUTION_MAX_LENGTH && worst_case(length_limit + 1) <= budget)
+	{
+		++length_limit;
+	}
+}
+
+std::string::size_type substitution_table::max_length() const
+{
+	return length_limit;
+}
+
+bool substitution_table::take(generation_state &state, std::uint32_t value, unsigned position) const
+{
+	if (!(value_positions[value] & position) || state.substitutions == constraints.max_substitutions)
+	{
+		return false;
 	}
+	const std::size_t *counts = value_counts.data() + value * constraints.limits.size();
+	for (std::size_t l = 0; l < constraints.limits.size(); ++l)
+	{
+		if (state.counts[l] + counts[l] > constraints.limits[l].max_count)
+		{
+			return false;
+		}
+	}
+
+	++state.substitutions;
+	for (std::size_t l = 0; l < constraints.limits.size(); ++l)
+	{
+		state.counts[l] += counts[l];
+	}
+	return true;
+}
+
+void substitution_table::give_back(generation_state &state, std::uint32_t value) const
+{
+	--state.substitutions;
+	const std::size_t *counts = value_counts.data() + value * constraints.limits.size();
+	for (std::size_t l = 0; l < constraints.limits.size(); ++l)
+	{
+		state.counts[l] -= counts[l];
+	}
+}
+
+/**
+ * Whether a forbidden sequence ends in current within what was appended from from on.
+ */
+bool substitution_table::has_forbidden(const std::string &current, std::string::size_type from, const generation_state &state) const
+{
+	for (std::string::size_type end = from + 1; end <= current.size(); ++end)
+	{
+		unsigned char last = current[end - 1];
+		for (std::uint32_t i = forbidden_ends[last]; i < forbidden_ends[last + 1]; ++i)
+		{
+			const std::string &sequence = forbidden[i];
+			if (state.forbidden[i] && sequence.size() <= end && current.compare(end - sequence.size(), sequence.size(), sequence) == 0)
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void substitution_table::generate_substitutions(const std::string &input, std::string::size_type index, std::string &current, const std::function<void(const std::string &)> &yield, const std::function<bool(const std::string &)> &viable, generation_state *state) const
+{
+	if (viable && !viable(current))
+	{
+		return;
+	}
+
+	if (index == input.size())
+	{
+		yield(current);
+		return;
+	}
+
+	std::string::size_type size = current.size();
+	current += input[index];
+	if (!state || !has_forbidden(current, size, *state))
+	{
+		if (state && input[index] == '-')
+		{
+			// Each part of a hyphenated compound is a word of its own to the limits
+			std::vector<std::size_t> counts(state->counts.size(), 0);
+			state->counts.swap(counts);
+			generate_substitutions(input, index + 1, current, yield, viable, state);
+			state->counts.swap(counts);
+		}
+		else
+		{
+			generate_substitutions(input, index + 1, current, yield, viable, state);
+		}
+	}
+	current.resize(size);
+
+	// Every key starting here, shortest first
+	std::uint32_t n = 0;
+	for (std::string::size_type end = index; end < input.size(); ++end)
+	{
+		unsigned char c = input[end];
+		if (c >= std::size(nodes[n].next) || (n = nodes[n].next[c]) == 0)
+		{
+			break;
+		}
+
+		// A key covering the whole word counts as both initial and final, and so does one
+		// covering a part of a hyphenated compound
+		unsigned position = 0;
+		if (index == 0 || input[index - 1] == '-')
+		{
+			position |= substitution_constraints::word_initial;
+		}
+		if (end + 1 == input.size() || input[end + 1] == '-')
+		{
+			position |= substitution_constraints::word_final;
+		}
+		if (position == 0)
+		{
+			position = substitution_constraints::word_medial;
+		}
+		for (std::uint32_t v = nodes[n].values_begin; v < nodes[n].values_end; ++v)
+		{
+			if (state && !take(*state, v, position))
+			{
+				continue;
+			}
+			current += values[v];
+			if (!state || !has_forbidden(current, size, *state))
+			{
+				generate_substitutions(input, end + 1, current, yield, viable, state);
+			}
+			current.resize(size);
+			if (state)
+			{
+				give_back(*state, v);
+			}
+		}
+	}
+}
+
+void substitution_table::for_each_substitution(const std::string &original, const std::function<void(const std::string &)> &yield, const std::function<bool(const std::string &)> &viable) const
+{
+	std::optional<generation_state> state;
+	if (constrained)
+	{
+		state.emplace();
+		state->counts.assign(constraints.limits.size(), 0);
+		for (const std::string &sequence : forbidden)
+		{
+			state->forbidden.push_back(original.find(sequence) == std::string::npos);
+		}
+	}
+	generation_state *constraint_state = state ? &*state : nullptr;
+
+	std::string current;
+	if (!may_repeat)
+	{
+		generate_substitutions(original, 0, current, yield, viable, constraint_state);
+		return;
+	}
+
+	std::unordered_set<std::string> seen;
+	generate_substitutions(original, 0, current, [&seen, &yield](const std::string &candidate)
+	{
+		if (seen.insert(candidate).second)
+		{
+			yield(candidate);
+		}
+	}, viable, constraint_state);
+}
+
+std::vector<std::string> substitution_table::substitute(const std::string &original) const
+{
+	std::vector<std::string> result;
+	for_each_substitution(original, [&result](const std::string &s)
+	{
+		result.push_back(s);
+	});
+	return result;
 }
@@ -0,0 +1,296 @@
+#include "sibel.h"
+
+#include <algorithm>
+
+static thread_local std::size_t current_worker = SIZE_MAX;
+static std::atomic<thread_pool *> current_pool(nullptr);
+
+thread_pool::thread_pool(std::size_t size) : pending(0), next_queue(0), n_workers(0), stopping(false), n_threads_started(0), n_tasks(0), n_steals(0)
+{
+	start(size);
+}
+
+thread_pool::~thread_pool()
+{
+	stop();
+}
+
+thread_pool &thread_pool::instance()
+{
+	// Never destroyed: worker threads must not be joined during static destruction
+	static std::once_flag created;
+	std::call_once(created, []
+	{
+		current_pool.store(new thread_pool(default_size()), std::memory_order_release);
+	});
+	return *current_pool.load(std::memory_order_acquire);
+}
+
+std::size_t thread_pool::default_size()
+{
+	std::size_t n = std::thread::hardware_concurrency();
+	return n == 0 ? 1 : n;
+}
+
+void thread_pool::start(std::size_t size)
+{
+	std::unique_lock<std::shared_mutex> lock(queues_mtx);
+
+	// Tasks still queued from before a resize are spread over the new queues
+	std::vector<queued_task> leftover;
+	for (auto &queue : queues)
+	{
+		std::move(queue->tasks.begin(), queue->tasks.end(), std::back_inserter(leftover));
+	}
+
+	queues.clear();
+	for (std::size_t i = 0; i < std::max<std::size_t>(size, 1); ++i)
+	{
+		queues.push_back(std::make_unique<worker_queue>());
+	}
+	for (std::size_t i = 0; i < leftover.size(); ++i)
+	{
+		queues[i % queues.size()]->tasks.push_back(std::move(leftover[i]));
+	}
+
+	n_workers = size;
+	stopping = false;
+	for (std::size_t i = 0; i < size; ++i)
+	{
+		workers.emplace_back(&thread_pool::work, this, i);
+	}
+	n_threads_started += size;
+}
+
+void thread_pool::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(idle_mtx);
+		stopping = true;
+	}
+	idle_cv.notify_all();
+
+	for (std::thread &t : workers)
+	{
+		t.join();
+	}
+	workers.clear();
+}
+
+std::size_t thread_pool::size()
+{
+	std::lock_guard<std::mutex> lock(resize_mtx);
+	return workers.size();
+}
+
+void thread_pool::resize(std::size_t size)
+{
+	{
+		std::lock_guard<std::mutex> lock(resize_mtx);
+		if (size == workers.size())
+		{
+			return;
+		}
+		stop();
+		start(size);
+	}
+
+	// Without workers the tasks left over would only be run if some group waited for them
+	std::function<void()> task;
+	while (size == 0 && try_pop(SIZE_MAX, nullptr, task))
+	{
+		task();
+		task = nullptr;
+	}
+}
+
+/**
+ * Takes a task of group, or any task if group is nullptr, from the back or the front of
+ * tasks. Called with the queue's mutex held.
+ */
+bool thread_pool::take(std::deque<queued_task> &tasks, bool from_back, const task_group *group, std::function<void()> &task)
+{
+	auto belongs = [group](const queued_task &t) { return group == nullptr || t.group == group; };
+	auto found = from_back ? std::find_if(tasks.rbegin(), tasks.rend(), belongs).base() : std::find_if(tasks.begin(), tasks.end(), belongs);
+	if (from_back ? found == tasks.begin() : found == tasks.end())
+	{
+		return false;
+	}
+	if (from_back)
+	{
+		--found;
+	}
+	task = std::move(found->run);
+	tasks.erase(found);
+	return true;
+}
+
+bool thread_pool::try_pop(std::size_t preferred, const task_group *group, std::function<void()> &task)
+{
+	std::shared_lock<std::shared_mutex> lock(queues_mtx);
+
+	if (preferred < queues.size())
+	{
+		worker_queue &own = *queues[preferred];
+		std::lock_guard<std::mutex> queue_lock(own.mtx);
+		if (take(own.tasks, true, group, task))
+		{
+			--pending;
+			return true;
+		}
+	}
+
+	for (std::size_t i = 0; i < queues.size(); ++i)
+	{
+		if (i == preferred)
+		{
+			continue;
+		}
+		worker_queue &victim = *queues[i];
+		std::lock_guard<std::mutex> queue_lock(victim.mtx);
+		if (take(victim.tasks, false, group, task))
+		{
+			--pending;
+			n_steals.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void thread_pool::work(std::size_t index)
+{
+	current_worker = index;
+	std::function<void()> task;
+
+	while (true)
+	{
+		if (try_pop(index, nullptr, task))
+		{
+			task();
+			task = nullptr;
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(idle_mtx);
+		idle_cv.wait(lock, [this] { return stopping || pending.load() > 0; });
+		if (stopping)
+		{
+			return;
+		}
+	}
+}
+
+void thread_pool::submit(std::function<void()> &&task, const task_group *group)
+{
+	{
+		std::shared_lock<std::shared_mutex> lock(queues_mtx);
+		if (group == nullptr && n_workers == 0)
+		{
+			// Nothing but the caller would ever run a task no group waits for
+			lock.unlock();
+			task();
+			return;
+		}
+		std::size_t index = current_worker < queues.size() ? current_worker : next_queue++ % queues.size();
+		std::lock_guard<std::mutex> queue_lock(queues[index]->mtx);
+		queues[index]->tasks.push_back({group, std::move(task)});
+		++pending;
+		n_tasks.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(idle_mtx);
+	}
+	idle_cv.notify_one();
+}
+
+bool thread_pool::run_pending_task(const task_group &group)
+{
+	std::function<void()> task;
+	if (try_pop(current_worker, &group, task))
+	{
+		task();
+		return true;
+	}
+	return false;
+}
+
+void thread_pool::replace_after_fork()
+{
+	// The old pool is left as it is: its workers are gone, and its locks may have been held
+	// by them when the process forked. If they were free, the tasks no group waits for are
+	// taken over; the waiters of the others were threads that are gone too
+	thread_pool &old = instance();
+	thread_pool *pool = new thread_pool(old.workers.size());
+	if (old.queues_mtx.try_lock())
+	{
+		for (auto &queue : old.queues)
+		{
+			if (!queue->mtx.try_lock())
+			{
+				continue;
+			}
+			for (queued_task &t : queue->tasks)
+			{
+				if (t.group == nullptr)
+				{
+					pool->submit(std::move(t.run));
+				}
+			}
+			queue->mtx.unlock();
+		}
+		old.queues_mtx.unlock();
+	}
+	current_pool.store(pool, std::memory_order_release);
+}
+
+std::uint64_t thread_pool::threads_started() const
+{
+	return n_threads_started.load();
+}
+
+std::uint64_t thread_pool::tasks_submitted() const
+{
+	return n_tasks.load();
+}
+
+std::uint64_t thread_pool::tasks_stolen() const
+{
+	return n_steals.load();
+}
+
+task_group::task_group() : outstanding(0) {}
+
+task_group::~task_group()
+{
+	wait();
+}
+
+void task_group::run(std::function<void()> &&task)
+{
+	++outstanding;
+	thread_pool::instance().submit([this, task = std::move(task)]
+	{
+		task();
+		std::lock_guard<std::mutex> lock(mtx);
+		if (--outstanding == 0)
+		{
+			cv.notify_all();
+		}
+	}, this);
+}
+
+void task_group::wait()
+{
+	thread_pool &pool = thread_pool::instance();
+	while (pool.run_pending_task(*this))
+	{
+	}
+
+	// Even once outstanding is 0, the last task may still hold mtx, so the group is only
+	// done with once its lock has been taken
+	std::unique_lock<std::mutex> lock(mtx);
+	cv.wait(lock, [this] { return outstanding.load() == 0; });
+}
@@ -0,0 +1,156 @@
+#include "sibel.h"
+
+#include <cstring>
+
+const std::size_t word_set::MAX_FORMS = 50000000;
+const std::uint32_t word_set::FILE_VERSION = 2;
+
+static const char WORD_SET_MAGIC[8] = {'S', 'I', 'B', 'E', 'L', 'W', 'R', 'D'};
+
+word_set::word_set() : image_size(0), hdr(nullptr), buckets(nullptr), forms(nullptr), arena(nullptr) {}
+
+void word_set::attach(const void *image)
+{
+	hdr = static_cast<const header *>(image);
+	buckets = reinterpret_cast<const std::uint32_t *>(hdr + 1);
+	forms = reinterpret_cast<const form_ref *>(buckets + hdr->n_buckets);
+	arena = reinterpret_cast<const char *>(forms + hdr->n_forms);
+}
+
+word_set *word_set::build(const affix_dictionary &dictionary, spelling_backend &backend)
+{
+	if (dictionary.transforms_input)
+	{
+		return nullptr;
+	}
+
+	std::string raw;
+	std::vector<std::uint32_t> raw_offsets;
+	bool complete = dictionary.expand([&](const std::string &form, bool standalone)
+	{
+		if (standalone)
+		{
+			raw_offsets.push_back(static_cast<std::uint32_t>(raw.size()));
+			raw += form;
+		}
+	}, MAX_FORMS);
+	if (!complete || raw.size() > UINT32_MAX)
+	{
+		return nullptr;
+	}
+	raw_offsets.push_back(static_cast<std::uint32_t>(raw.size()));
+
+	auto raw_form = [&](std::uint32_t i)
+	{
+		return std::string_view(raw).substr(raw_offsets[i], raw_offsets[i + 1] - raw_offsets[i]);
+	};
+
+	std::vector<std::uint32_t> order(raw_offsets.size() - 1);
+	for (std::uint32_t i = 0; i < order.size(); ++i)
+	{
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b)
+	{
+		return raw_form(a) < raw_form(b);
+	});
+	order.erase(std::unique(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b)
+	{
+		return raw_form(a) == raw_form(b);
+	}), order.end());
+
+	// The enumeration knows nothing of forbidden words, CHECKSHARPS and the like, so every
+	// form is checked once here rather than risk accepting a word the backend would not
+	std::vector<form_ref> new_forms;
+	std::string new_arena;
+	std::string form;
+	for (std::uint32_t i : order)
+	{
+		form.assign(raw_form(i));
+		if (backend.spell(form))
+		{
+			new_forms.push_back({static_cast<std::uint32_t>(new_arena.size()), static_cast<std::uint32_t>(form.size())});
+			new_arena += form;
+		}
+	}
+
+	std::uint64_t n_buckets = 1;
+	while (n_buckets < 2 * new_forms.size())
+	{
+		n_buckets *= 2;
+	}
+	std::vector<std::uint32_t> new_buckets(n_buckets, 0);
+	for (std::uint32_t i = 0; i < new_forms.size(); ++i)
+	{
+		std::uint64_t b = orthographic_index::hash(std::string_view(new_arena).substr(new_forms[i].offset, new_forms[i].length)) & (n_buckets - 1);
+		while (new_buckets[b] != 0)
+		{
+			b = (b + 1) & (n_buckets - 1);
+		}
+		new_buckets[b] = i + 1;
+	}
+
+	header h{n_buckets, new_forms.size(), new_arena.size()};
+	std::size_t size = sizeof(header) + n_buckets * sizeof(std::uint32_t) + new_forms.size() * sizeof(form_ref) + new_arena.size();
+
+	word_set *set = new word_set();
+	set->image_size = size;
+	set->storage.resize((size + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t));
+	char *p = reinterpret_cast<char *>(set->storage.data());
+	std::memcpy(p, &h, sizeof(header));
+	p += sizeof(header);
+	std::memcpy(p, new_buckets.data(), n_buckets * sizeof(std::uint32_t));
+	p += n_buckets * sizeof(std::uint32_t);
+	std::memcpy(p, new_forms.data(), new_forms.size() * sizeof(form_ref));
+	p += new_forms.size() * sizeof(form_ref);
+	std::memcpy(p, new_arena.data(), new_arena.size());
+	set->attach(set->storage.data());
+	return set;
+}
+
+word_set *word_set::open(const std::filesystem::path &path, const std::filesystem::path &aff_path, const std::filesystem::path &dic_path)
+{
+	std::unique_ptr<mapped_file> file(open_image(path, WORD_SET_MAGIC, FILE_VERSION, aff_path, dic_path));
+	if (!file || file->size() < image_offset() + sizeof(header))
+	{
+		return nullptr;
+	}
+
+	std::size_t size = file->size() - image_offset();
+	const header *h = reinterpret_cast<const header *>(file->data() + image_offset());
+	std::uint64_t expected = sizeof(header) + h->n_buckets * sizeof(std::uint32_t) + h->n_forms * sizeof(form_ref) + h->arena_size;
+	if (expected != size || h->n_buckets == 0 || (h->n_buckets & (h->n_buckets - 1)) != 0)
+	{
+		return nullptr;
+	}
+
+	word_set *set = new word_set();
+	set->image_size = size;
+	set->attach(h);
+	set->mapping = std::move(file);
+	return set;
+}
+
+bool word_set::save(const std::filesystem::path &path, const std::filesystem::path &aff_path, const std::filesystem::path &dic_path) const
+{
+	return save_image(path, WORD_SET_MAGIC, FILE_VERSION, aff_path, dic_path, hdr, image_size);
+}
+
+bool word_set::contains(std::string_view word) const
+{
+	std::uint64_t mask = hdr->n_buckets - 1;
+	for (std::uint64_t b = orthographic_index::hash(word) & mask; buckets[b] != 0; b = (b + 1) & mask)
+	{
+		const form_ref &f = forms[buckets[b] - 1];
+		if (std::string_view(arena + f.offset, f.length) == word)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+std::size_t word_set::size() const
+{
+	return hdr->n_forms;
+}
@@ -0,0 +1,75 @@
+#include "sibel.h"
+
+#include <memory>
+#include <unicode/brkiter.h>
+#include <unicode/utext.h>
+
+static std::size_t count_code_points(const char *begin, const char *end)
+{
+	std::size_t n = 0;
+	for (const char *p = begin; p < end; ++p)
+	{
+		// Every byte but the continuation bytes starts a code point
+		n += (static_cast<unsigned char>(*p) & 0xC0) != 0x80;
+	}
+	return n;
+}
+
+bool for_each_word(std::string_view text, const std::function<void(std::size_t, std::size_t, std::string_view)> &yield)
+{
+	if (text.size() > static_cast<std::size_t>(INT32_MAX))
+	{
+		return false;
+	}
+
+	// Creating a break iterator loads the rules, so each thread keeps one
+	thread_local std::unique_ptr<icu::BreakIterator> words;
+	UErrorCode err = U_ZERO_ERROR;
+	if (!words)
+	{
+		words.reset(icu::BreakIterator::createWordInstance(icu::Locale::getRoot(), err));
+		if (U_FAILURE(err))
+		{
+			words.reset();
+			return false;
+		}
+	}
+
+	UText ut = UTEXT_INITIALIZER;
+	utext_openUTF8(&ut, text.data(), static_cast<int64_t>(text.size()), &err);
+	words->setText(&ut, err);
+	if (U_FAILURE(err))
+	{
+		utext_close(&ut);
+		return false;
+	}
+
+	// With UTF-8 text, the boundaries are byte offsets, which for ASCII are code point offsets too
+	bool ascii = classify(text).ascii;
+	int32_t counted_to = 0;
+	std::size_t code_points = 0;
+	int32_t start = words->first();
+	for (int32_t end = words->next(); end != icu::BreakIterator::DONE; start = end, end = words->next())
+	{
+		// Numbers, punctuation and spaces are not words to check
+		int32_t status = words->getRuleStatus();
+		if (status < UBRK_WORD_LETTER)
+		{
+			continue;
+		}
+
+		if (ascii)
+		{
+			code_points = start;
+		}
+		else
+		{
+			code_points += count_code_points(text.data() + counted_to, text.data() + start);
+			counted_to = start;
+		}
+		yield(start, code_points, text.substr(start, end - start));
+	}
+
+	utext_close(&ut);
+	return true;
+}